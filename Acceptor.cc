@@ -1,16 +1,25 @@
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "EventLoop.h"
+#include "Timer.h"
+#include "Trace.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
-// 创建一个listenfd
-static int createNonblocking()
+// 创建一个listenfd，协议族和监听地址一致
+static int createNonblocking(const InetAddress &listenAddr)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(!listenAddr.valid())
+    {
+        LOG_FATAL("%s:%s:%d invalid listen address \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    int sockfd = ::socket(listenAddr.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if(sockfd < 0)
     {
         LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
@@ -18,21 +27,87 @@ static int createNonblocking()
     return sockfd;
 }
 
+// 上次运行留下的socket文件会让bind失败（EADDRINUSE），只删除socket类型的文件，避免误删普通文件
+// 先试着连一下：还有进程在监听时（另一个实例，或者没走交接的重启）保留文件，让bind报EADDRINUSE，
+// 否则会悄悄抢走路径，旧服务器从此连不上却没有任何报错；只有ECONNREFUSED说明没人监听
+static void unlinkStaleSocketFile(const InetAddress &addr)
+{
+    if(!addr.isUnix() || addr.isAbstract())
+    {
+        return;
+    }
+    std::string path = addr.unixPath();
+    struct stat st;
+    if(path.empty() || ::lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode))
+    {
+        return;
+    }
+    int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(probe < 0)
+    {
+        return;
+    }
+    if(::connect(probe, addr.sockAddr(), addr.sockAddrLen()) < 0 && errno == ECONNREFUSED)
+    {
+        ::unlink(path.c_str());
+    }
+    else
+    {
+        LOG_ERROR("%s:%s:%d %s is still in use, not removing it \n", __FILE__, __FUNCTION__, __LINE__, path.c_str());
+    }
+    ::close(probe);
+}
+
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop)
-    , acceptSocket_(createNonblocking())
+    , acceptSocket_(createNonblocking(listenAddr))
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , maxConnections_(0)
+    , overloadRecheckInterval_(0.0)
+    , paused_(false)
+    , accepted_(0)
+    , rejected_(0)
+    , deferred_(0)
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if(listenAddr.isUnix())
+    {
+        // Unix域socket没有TIME_WAIT和端口复用，同一路径只能有一个监听者
+        // 析构时不删除socket文件：热升级时新进程还在用继承来的listenfd
+        unlinkStaleSocketFile(listenAddr);
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(true);
+    }
     acceptSocket_.bindAddress(listenAddr);
     //TcpServer::start() Acceptor.listen 有新用户连接，要执行一个回调 connfd->channel->subloop
     // baseLoop -> acceptChannel_(listenfd)
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
+Acceptor::Acceptor(EventLoop *loop, int listenfd)
+    : loop_(loop)
+    , acceptSocket_(listenfd)
+    , acceptChannel_(loop, listenfd)
+    , listenning_(false)
+    , maxConnections_(0)
+    , overloadRecheckInterval_(0.0)
+    , paused_(false)
+    , accepted_(0)
+    , rejected_(0)
+    , deferred_(0)
+{
+    // 继承来的fd不一定是非阻塞的，accept必须非阻塞
+    int flags = ::fcntl(listenfd, F_GETFL, 0);
+    ::fcntl(listenfd, F_SETFL, flags | O_NONBLOCK);
+    ::fcntl(listenfd, F_SETFD, FD_CLOEXEC);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
+    loop_->cancel(resumeTimer_);
     acceptChannel_.disableAll(); // 取消关注fd上任何事件
     acceptChannel_.remove();
 }
@@ -41,17 +116,77 @@ Acceptor::~Acceptor()
 void Acceptor::listen()
 {
     listenning_ = true;
-    acceptSocket_.listen();
+    // 接管来的fd不知道地址族，按bind的地址判断
+    socketOptions_.applyToListener(acceptSocket_, !Socket::getLocalAddr(acceptSocket_.fd()).isUnix());
+    acceptSocket_.listen(socketOptions_.backlog);
     acceptChannel_.enableReading(); // acceptChannel -> Poller
 }
 
+void Acceptor::stopListening()
+{
+    if(listenning_)
+    {
+        listenning_ = false;
+        paused_ = false;
+        loop_->cancel(resumeTimer_);
+        acceptChannel_.disableAll();
+        acceptChannel_.remove();
+    }
+}
+
+void Acceptor::setRateLimit(double rate, double burst)
+{
+    // 至少要能攒够一个令牌
+    rateLimit_.reset(rate, burst < 1.0 ? 1.0 : burst);
+}
+
+void Acceptor::setMaxConnections(size_t maxConnections, const ConnectionCountCallback &countCb)
+{
+    maxConnections_ = maxConnections;
+    connectionCountCallback_ = countCb;
+}
+
+void Acceptor::setOverloadCallback(const OverloadCallback &cb, double recheckInterval)
+{
+    overloadCallback_ = cb;
+    overloadRecheckInterval_ = recheckInterval;
+}
+
 // listenfd有事件发生了，就是有新用户连接了
 void Acceptor::handleRead()
 {
+    // subLoop处理不过来，先不accept，让连接在内核backlog中等待
+    if(overloadCallback_ && overloadCallback_())
+    {
+        pauseAccepting(overloadRecheckInterval_);
+        return;
+    }
+    // 超过accept速率，等到下一个令牌产生
+    if(!rateLimit_.unlimited())
+    {
+        int64_t now = Timer::now();
+        if(!rateLimit_.tryConsume(1.0, now))
+        {
+            pauseAccepting(static_cast<double>(rateLimit_.delayFor(1.0, now)) / Timer::kMicroSecondsPerSecond);
+            return;
+        }
+    }
+
     InetAddress peerAddr;
     int connfd = acceptSocket_.accept(&peerAddr);
     if(connfd >= 0)
     {
+        MYMUDUO_PROBE1(accept, connfd);
+        // 连接数已满，直接关闭，让客户端尽快失败而不是在backlog里超时
+        if(maxConnections_ > 0 && connectionCountCallback_
+            && connectionCountCallback_() >= maxConnections_)
+        {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            ::close(connfd);
+            return;
+        }
+
+        accepted_.fetch_add(1, std::memory_order_relaxed);
         if(newConnectionCallback_)
         {
             // 轮询找到subLoop，唤醒，分发当前新客户连接的Channel
@@ -70,4 +205,24 @@ void Acceptor::handleRead()
             LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
         }
     }
-}
\ No newline at end of file
+}
+
+void Acceptor::pauseAccepting(double delay)
+{
+    deferred_.fetch_add(1, std::memory_order_relaxed);
+    if(!paused_)
+    {
+        paused_ = true;
+        acceptChannel_.disableReading();
+        resumeTimer_ = loop_->runAfter(delay, std::bind(&Acceptor::resumeAccepting, this));
+    }
+}
+
+void Acceptor::resumeAccepting()
+{
+    if(paused_ && listenning_)
+    {
+        paused_ = false;
+        acceptChannel_.enableReading(); // 还有连接在backlog中时会立即触发handleRead
+    }
+}
@@ -3,7 +3,11 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "TimerId.h"
+#include "TokenBucket.h"
+#include "SocketOptions.h"
 
+#include <atomic>
 #include <functional>
 
 class EventLoop;
@@ -13,7 +17,13 @@ class Acceptor : noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+    // 返回当前连接数
+    using ConnectionCountCallback = std::function<size_t()>;
+    // 返回true表示下游（subLoop）已经处理不过来
+    using OverloadCallback = std::function<bool()>;
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    // 接管一个已经bind并listen的socket，如平滑重启时从旧进程传过来的fd
+    Acceptor(EventLoop *loop, int listenfd);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback& cb)
@@ -23,9 +33,32 @@ public:
 
     bool listenning() const { return listenning_; }
     void listen();
+    // 不再accept新连接，监听socket保持打开直到Acceptor析构
+    void stopListening();
+
+    int listenFd() const { return acceptSocket_.fd(); }
+
+    // 监听socket的选项，在listen()时生效
+    void setSocketOptions(const SocketOptions &opts) { socketOptions_ = opts; }
+
+    // 准入控制，需在loop线程中设置
+    // 每秒最多accept rate个连接，允许burst个突发；超出时暂停accept，连接留在内核backlog中
+    void setRateLimit(double rate, double burst);
+    // 连接数达到maxConnections时，新连接accept后立即关闭
+    void setMaxConnections(size_t maxConnections, const ConnectionCountCallback &countCb);
+    // cb返回true时暂停accept，每隔recheckInterval秒重新检查
+    void setOverloadCallback(const OverloadCallback &cb, double recheckInterval);
+
+    // 计数，可在任意线程读取
+    uint64_t numAccepted() const { return accepted_.load(std::memory_order_relaxed); }
+    uint64_t numRejected() const { return rejected_.load(std::memory_order_relaxed); }
+    uint64_t numDeferred() const { return deferred_.load(std::memory_order_relaxed); }
 
 private:
     void handleRead();
+    // 暂停accept delay秒，之后重新关注listenfd的读事件
+    void pauseAccepting(double delay);
+    void resumeAccepting();
 
     EventLoop *loop_; // Acceptor就是用户定义的baseLoop，亦称为 mainLoop
     // 创建普通成员必须引入头文件了
@@ -35,4 +68,17 @@ private:
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    SocketOptions socketOptions_;
+
+    TokenBucket rateLimit_;
+    size_t maxConnections_; // 0表示不限制
+    ConnectionCountCallback connectionCountCallback_;
+    OverloadCallback overloadCallback_;
+    double overloadRecheckInterval_;
+    bool paused_;
+    TimerId resumeTimer_;
+
+    std::atomic<uint64_t> accepted_;
+    std::atomic<uint64_t> rejected_; // 超过最大连接数被关闭的
+    std::atomic<uint64_t> deferred_; // 因限速或过载暂停accept的次数
 };
\ No newline at end of file
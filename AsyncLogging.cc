@@ -0,0 +1,191 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+
+#include <chrono>
+#include <stdio.h>
+
+const size_t AsyncLogging::kBufferSize;
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                off_t rollSize,
+                int flushInterval,
+                int rollInterval,
+                size_t maxPendingBuffers,
+                OverflowPolicy policy)
+    : flushInterval_(flushInterval)
+    , rollInterval_(rollInterval)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , maxPendingBuffers_(maxPendingBuffers > 0 ? maxPendingBuffers : 1)
+    , policy_(policy)
+    , running_(false)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , flushRequested_(0)
+    , flushCompleted_(0)
+    , dropped_(0)
+{
+    buffers_.reserve(maxPendingBuffers_);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if(running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void AsyncLogging::append(const char *logline, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len);
+        return;
+    }
+
+    // 当前缓冲区写满了，交给后台线程
+    while(buffers_.size() >= maxPendingBuffers_)
+    {
+        if(policy_ == kDrop || !running_)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        spaceCond_.wait(lock);
+    }
+    buffers_.push_back(std::move(currentBuffer_));
+    if(nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_.reset(new LogBuffer); // 很少发生，前端写得太快，两块都用完了
+    }
+    if(len < kBufferSize)
+    {
+        currentBuffer_->append(logline, len);
+    }
+    else
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed); // 比整块缓冲区还长的行
+    }
+    cond_.notify_one();
+}
+
+void AsyncLogging::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(!running_)
+    {
+        return;
+    }
+    uint64_t ticket = ++flushRequested_;
+    cond_.notify_one();
+    spaceCond_.wait(lock, [this, ticket]() { return flushCompleted_ >= ticket || !running_; });
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, rollInterval_, flushInterval_);
+    // 后台线程预留两块缓冲区，交换时直接给前端，避免在锁内分配内存
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(maxPendingBuffers_ + 1);
+    uint64_t reportedDropped = 0;
+
+    bool running = true;
+    while(running)
+    {
+        uint64_t flushTicket = 0; // 非0表示本轮写完后要完成的flush()请求
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if(buffers_.empty() && flushRequested_ == flushCompleted_ && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if(!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+            if(flushRequested_ != flushCompleted_)
+            {
+                flushTicket = flushRequested_;
+            }
+            running = running_;
+        }
+        // 积压的缓冲区已经全部取走，kBlock下等待的前端可以继续
+        spaceCond_.notify_all();
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if(dropped != reportedDropped)
+        {
+            char buf[128];
+            int n = snprintf(buf, sizeof buf, "[ERROR] AsyncLogging dropped %llu log messages\n",
+                static_cast<unsigned long long>(dropped - reportedDropped));
+            output.append(buf, n);
+            reportedDropped = dropped;
+        }
+
+        for(const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 留两块给下一轮用，其余释放
+        if(buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if(!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if(!newBuffer2)
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+
+        if(flushTicket != 0 || !running)
+        {
+            output.flush();
+        }
+        if(flushTicket != 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                flushCompleted_ = flushTicket;
+            }
+            spaceCond_.notify_all();
+        }
+    }
+    output.flush();
+}
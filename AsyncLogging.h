@@ -0,0 +1,107 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <sys/types.h>
+
+// 异步日志后端：前端线程只把格式化好的日志行拷贝进内存缓冲区，后台线程批量写入滚动文件
+// 双缓冲：前端写currentBuffer_，写满后挂到buffers_并换上备用的nextBuffer_；
+// 后台线程每flushInterval秒或有缓冲区写满时醒来，一次把所有写满的缓冲区交换出来，在锁外写文件
+// 前端只在缓冲区写满时才唤醒后台线程，平时没有系统调用
+//
+// 用法：
+//   AsyncLogging log("/var/log/server", 512 * 1024 * 1024);
+//   log.start();
+//   Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, _1, _2));
+//   Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+class AsyncLogging : noncopyable
+{
+public:
+    // 后台线程跟不上、积压的缓冲区达到上限时前端的做法
+    enum OverflowPolicy
+    {
+        kDrop,  // 丢弃新的日志行并计数，不阻塞I/O线程
+        kBlock, // 阻塞写日志的线程，直到后台线程腾出空间
+    };
+
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+
+    // rollSize：单个文件的最大字节数；rollInterval：按时间滚动的周期（秒）
+    // maxPendingBuffers：等待后台线程写出的缓冲区个数上限
+    AsyncLogging(const std::string &basename,
+                off_t rollSize,
+                int flushInterval = 3,
+                int rollInterval = 24 * 3600,
+                size_t maxPendingBuffers = 16,
+                OverflowPolicy policy = kDrop);
+    ~AsyncLogging();
+
+    // 前端接口，可在任意线程调用
+    void append(const char *logline, size_t len);
+    // 等到此前append的所有日志都写进文件并fflush后返回，LOG_FATAL退出前会调用
+    void flush();
+
+    void start();
+    // 写完剩余的日志后停止后台线程
+    void stop();
+
+    // 因积压被丢弃的日志行数
+    uint64_t numDropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    // 固定大小的日志缓冲区
+    class LogBuffer : noncopyable
+    {
+    public:
+        LogBuffer() : data_(new char[kBufferSize]), len_(0) {}
+
+        size_t avail() const { return kBufferSize - len_; }
+        void append(const char *buf, size_t len)
+        {
+            memcpy(data_.get() + len_, buf, len);
+            len_ += len;
+        }
+        const char* data() const { return data_.get(); }
+        size_t length() const { return len_; }
+        void reset() { len_ = 0; }
+
+    private:
+        std::unique_ptr<char[]> data_;
+        size_t len_;
+    };
+
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+
+    const int flushInterval_;
+    const int rollInterval_;
+    const std::string basename_;
+    const off_t rollSize_;
+    const size_t maxPendingBuffers_;
+    const OverflowPolicy policy_;
+
+    std::atomic_bool running_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;      // 唤醒后台线程
+    std::condition_variable spaceCond_; // kBlock时等待积压减少；flush()时等待写完
+    BufferPtr currentBuffer_;
+    BufferPtr nextBuffer_;
+    BufferVector buffers_; // 已写满、等待后台线程写出的缓冲区
+
+    // flush()请求的序号和后台线程已完成的序号，由mutex_保护
+    uint64_t flushRequested_;
+    uint64_t flushCompleted_;
+
+    std::atomic<uint64_t> dropped_;
+};
@@ -0,0 +1,278 @@
+#include "BinaryLog.h"
+#include "CurrentThread.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+
+std::atomic_bool BinaryLog::started_(false);
+
+namespace
+{
+    // 线程退出时把环标记为孤儿，后台线程读完剩余数据后释放
+    struct RingHolder
+    {
+        ~RingHolder()
+        {
+            if(ring)
+            {
+                ring->orphaned.store(true, std::memory_order_release);
+            }
+        }
+        std::shared_ptr<BinaryLogRing> ring;
+    };
+
+    thread_local RingHolder t_ringHolder;
+    __thread BinaryLogRing *t_ring = nullptr;
+
+    size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t cap = 4096;
+        while(cap < n)
+        {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    void writeBytes(FILE *fp, const void *data, size_t len)
+    {
+        ::fwrite_unlocked(data, 1, len, fp);
+    }
+
+    void writeU32(FILE *fp, uint32_t v) { writeBytes(fp, &v, sizeof v); }
+    void writeI32(FILE *fp, int32_t v) { writeBytes(fp, &v, sizeof v); }
+
+    void writeString(FILE *fp, const std::string &s)
+    {
+        writeU32(fp, static_cast<uint32_t>(s.size()));
+        writeBytes(fp, s.data(), s.size());
+    }
+}
+
+BinaryLog& BinaryLog::instance()
+{
+    static BinaryLog blog;
+    return blog;
+}
+
+BinaryLog::BinaryLog()
+    : sitesWritten_(0)
+    , ringSize_(1 << 20)
+    , pollIntervalMs_(10)
+    , fp_(nullptr)
+    , running_(false)
+    , dropped_(0)
+    , droppedWritten_(0)
+{
+}
+
+BinaryLog::~BinaryLog()
+{
+    if(started())
+    {
+        stop();
+    }
+}
+
+bool BinaryLog::start(const std::string &path, size_t ringSize, int pollIntervalMs)
+{
+    if(started())
+    {
+        return false;
+    }
+    fp_ = ::fopen(path.c_str(), "we");
+    if(fp_ == nullptr)
+    {
+        LOG_ERROR("BinaryLog::start open %s failed errno:%d \n", path.c_str(), errno);
+        return false;
+    }
+    writeBytes(fp_, blog::kFileMagic, sizeof blog::kFileMagic);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ringSize_ = roundUpPowerOfTwo(ringSize);
+    }
+    pollIntervalMs_ = pollIntervalMs > 0 ? pollIntervalMs : 1;
+    sitesWritten_ = 0; // 新文件要重新写一遍所有调用点
+    droppedWritten_ = dropped_.load(std::memory_order_relaxed);
+
+    running_ = true;
+    thread_.reset(new Thread(std::bind(&BinaryLog::threadFunc, this), "BinaryLog"));
+    thread_->start();
+    started_.store(true, std::memory_order_release);
+    return true;
+}
+
+void BinaryLog::stop()
+{
+    if(!started())
+    {
+        return;
+    }
+    started_.store(false, std::memory_order_release);
+    running_ = false;
+    thread_->join();
+    thread_.reset();
+    ::fclose(fp_);
+    fp_ = nullptr;
+}
+
+uint32_t BinaryLog::registerSite(LogLevel level, const char *file, int line, const char *fmt,
+                                const uint8_t *types, size_t nargs)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Site site;
+    site.id = static_cast<uint32_t>(sites_.size() + 1); // 0表示还未登记
+    site.level = level;
+    site.line = line;
+    site.file = file;
+    site.fmt = fmt;
+    site.types.assign(types, types + nargs);
+    sites_.push_back(std::move(site));
+    return sites_.back().id;
+}
+
+int64_t BinaryLog::nowMicros()
+{
+    return Timestamp::now().microSecondsSinceEpoch();
+}
+
+BinaryLogRing* BinaryLog::threadRing()
+{
+    if(__builtin_expect(t_ring == nullptr, 0))
+    {
+        BinaryLog &blog = instance();
+        std::unique_lock<std::mutex> lock(blog.mutex_);
+        std::shared_ptr<BinaryLogRing> ring(std::make_shared<BinaryLogRing>(blog.ringSize_, CurrentThread::tid()));
+        blog.rings_.push_back(ring);
+        t_ringHolder.ring = ring;
+        t_ring = ring.get();
+    }
+    return t_ring;
+}
+
+char* BinaryLog::reserve(size_t size)
+{
+    BinaryLogRing *ring = threadRing();
+    const size_t cap = ring->capacity;
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    size_t head = ring->head.load(std::memory_order_acquire);
+    size_t offset = tail & (cap - 1);
+    // 记录必须连续存放，环尾放不下时用填充补齐，从头开始写
+    size_t pad = offset + size > cap ? cap - offset : 0;
+    if(size > cap || tail + pad + size - head > cap)
+    {
+        instance().dropped_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    if(pad > 0)
+    {
+        // 偏移和记录长度都按8字节对齐，填充至少能放下一个8字节的头
+        uint32_t header[2] = { blog::kPadSite, static_cast<uint32_t>(pad) };
+        memcpy(ring->data.get() + offset, header, sizeof header);
+        ring->tail.store(tail + pad, std::memory_order_release);
+        offset = 0;
+    }
+    return ring->data.get() + offset;
+}
+
+void BinaryLog::commit(size_t size)
+{
+    BinaryLogRing *ring = t_ring;
+    ring->tail.store(ring->tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+void BinaryLog::writeSites()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(; sitesWritten_ < sites_.size(); ++sitesWritten_)
+    {
+        const Site &site = sites_[sitesWritten_];
+        writeBytes(fp_, "S", 1);
+        writeU32(fp_, site.id);
+        writeI32(fp_, site.level);
+        writeI32(fp_, site.line);
+        writeU32(fp_, static_cast<uint32_t>(site.types.size()));
+        writeBytes(fp_, site.types.data(), site.types.size());
+        writeString(fp_, site.file);
+        writeString(fp_, site.fmt);
+    }
+}
+
+size_t BinaryLog::collect()
+{
+    std::vector<std::shared_ptr<BinaryLogRing>> rings;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+    // 先读各环的tail再写调用点表：tail之前的记录所用的调用点一定已经登记过
+    std::vector<bool> orphaned(rings.size());
+    std::vector<size_t> tails(rings.size());
+    for(size_t i = 0; i < rings.size(); ++i)
+    {
+        orphaned[i] = rings[i]->orphaned.load(std::memory_order_acquire);
+        tails[i] = rings[i]->tail.load(std::memory_order_acquire);
+    }
+    writeSites();
+
+    size_t total = 0;
+    bool removeOrphans = false;
+    for(size_t i = 0; i < rings.size(); ++i)
+    {
+        BinaryLogRing *ring = rings[i].get();
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        size_t tail = tails[i];
+        if(tail != head)
+        {
+            size_t nbytes = tail - head;
+            size_t offset = head & (ring->capacity - 1);
+            size_t first = std::min(nbytes, ring->capacity - offset);
+            writeBytes(fp_, "R", 1);
+            writeI32(fp_, ring->tid);
+            writeU32(fp_, static_cast<uint32_t>(nbytes));
+            writeBytes(fp_, ring->data.get() + offset, first);
+            writeBytes(fp_, ring->data.get(), nbytes - first);
+            ring->head.store(tail, std::memory_order_release);
+            total += nbytes;
+        }
+        removeOrphans = removeOrphans || orphaned[i];
+    }
+
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if(dropped != droppedWritten_)
+    {
+        writeBytes(fp_, "D", 1);
+        uint64_t delta = dropped - droppedWritten_;
+        writeBytes(fp_, &delta, sizeof delta);
+        droppedWritten_ = dropped;
+    }
+
+    if(removeOrphans)
+    {
+        // 线程退出前写的记录在本轮已经全部读出
+        std::unique_lock<std::mutex> lock(mutex_);
+        for(size_t i = 0; i < rings.size(); ++i)
+        {
+            if(orphaned[i])
+            {
+                rings_.erase(std::remove(rings_.begin(), rings_.end(), rings[i]), rings_.end());
+            }
+        }
+    }
+    return total;
+}
+
+void BinaryLog::threadFunc()
+{
+    while(running_)
+    {
+        collect();
+        ::fflush(fp_);
+        ::usleep(pollIntervalMs_ * 1000);
+    }
+    // 停止前再收集一次
+    collect();
+    ::fflush(fp_);
+}
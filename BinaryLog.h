@@ -0,0 +1,263 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Logger.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// 二进制日志：热路径不做格式化，只记录 调用点id + 时间戳 + 参数原始字节，离线用tools/blogdecode还原成文本
+// 1. 每个调用点第一次执行时登记格式串、文件行号和参数类型，得到一个id
+// 2. 每个线程一个单生产者单消费者的环形缓冲区，写日志只是一次memcpy和一次release store，不加锁
+// 3. 后台线程定期把各线程环中的数据原样写入文件，环满时丢弃新记录并计数，不阻塞I/O线程
+//
+// 用法和LOG_*相同，受同一个运行时阈值和编译期下限控制：
+//   BinaryLog::instance().start("/var/log/server.blog");
+//   BLOG_INFO("conn %s recv %d bytes", conn->name().c_str(), n);
+// 没有start()时BLOG_*退化为普通的文本日志
+// 格式串只支持printf的基本转换（d i u x X o c s p f e g a 及其长度修饰），不支持 * 宽度
+
+#define MYMUDUO_BLOG_IMPL(level, logmsgFormat, ...) \
+    do \
+    {   \
+        if(Logger::logLevel() <= level) \
+        {   \
+            static std::atomic<uint32_t> mymuduoBlogSite(0); \
+            BinaryLog::log(&mymuduoBlogSite, level, __FILE__, __LINE__, logmsgFormat, ##__VA_ARGS__); \
+        }   \
+        if(false) \
+        {   \
+            BinaryLog::checkFormat(logmsgFormat, ##__VA_ARGS__); \
+        }   \
+    }while(0)
+
+#if MYMUDUO_LOG_FLOOR <= 0
+#define BLOG_DEBUG(logmsgFormat, ...) MYMUDUO_BLOG_IMPL(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#else
+#define BLOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_FLOOR <= 1
+#define BLOG_INFO(logmsgFormat, ...) MYMUDUO_BLOG_IMPL(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define BLOG_INFO(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(INFO, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_FLOOR <= 2
+#define BLOG_ERROR(logmsgFormat, ...) MYMUDUO_BLOG_IMPL(ERROR, logmsgFormat, ##__VA_ARGS__)
+#else
+#define BLOG_ERROR(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(ERROR, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+// 文件格式（小端，本机字节序）:
+//   文件头 kFileMagic
+//   'S' 调用点: u32 id, i32 level, i32 line, u32 nargs, u8 types[nargs], u32 len + file, u32 len + fmt
+//   'R' 一段记录: i32 tid, u32 nbytes, 若干条记录（8字节对齐）
+//        记录: u32 site, u32 size（含头部）, i64 微秒时间戳, 参数
+//        参数: 整数/浮点/指针各8字节，字符串为 u32 len + 字节
+//        site为kPadSite时是环形缓冲区尾部的填充，跳过size字节
+//   'D' u64 丢弃的记录数
+namespace blog
+{
+    enum ArgType : uint8_t
+    {
+        kSigned = 1,
+        kUnsigned,
+        kDouble,
+        kString,
+        kPointer,
+    };
+
+    const char kFileMagic[8] = { 'M', 'U', 'D', 'U', 'O', 'B', 'L', '1' };
+    const uint32_t kPadSite = 0xffffffff;
+    const size_t kRecordHeaderSize = 16;
+
+    inline size_t align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+    // 参数的类型标签和编码，不支持的类型在编译期报错
+    template <typename T, typename Enable = void>
+    struct Arg;
+
+    template <typename T>
+    struct Arg<T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type>
+    {
+        static const uint8_t kType = std::is_signed<T>::value || std::is_enum<T>::value ? kSigned : kUnsigned;
+        static size_t size(T) { return 8; }
+        static char* encode(char *p, T v)
+        {
+            int64_t x = static_cast<int64_t>(v);
+            memcpy(p, &x, 8);
+            return p + 8;
+        }
+    };
+
+    template <typename T>
+    struct Arg<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        static const uint8_t kType = kDouble;
+        static size_t size(T) { return 8; }
+        static char* encode(char *p, T v)
+        {
+            double x = static_cast<double>(v);
+            memcpy(p, &x, 8);
+            return p + 8;
+        }
+    };
+
+    template <typename T>
+    struct Arg<T*, typename std::enable_if<std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    {
+        static const uint8_t kType = kString;
+        static size_t size(const char *s) { return 4 + (s ? strlen(s) : 0); }
+        static char* encode(char *p, const char *s)
+        {
+            uint32_t len = s ? static_cast<uint32_t>(strlen(s)) : 0;
+            memcpy(p, &len, 4);
+            memcpy(p + 4, s, len);
+            return p + 4 + len;
+        }
+    };
+
+    template <typename T>
+    struct Arg<T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    {
+        static const uint8_t kType = kPointer;
+        static size_t size(const void*) { return 8; }
+        static char* encode(char *p, const void *v)
+        {
+            uint64_t x = reinterpret_cast<uintptr_t>(v);
+            memcpy(p, &x, 8);
+            return p + 8;
+        }
+    };
+
+    template <typename T>
+    using Decayed = typename std::decay<T>::type;
+}
+
+// 每个线程一个，线程本身是唯一的生产者，后台线程是唯一的消费者
+struct BinaryLogRing : noncopyable
+{
+    BinaryLogRing(size_t cap, int threadId)
+        : data(new char[cap]()) // 清零，提前触发缺页，不把缺页的开销留给热路径
+        , capacity(cap)
+        , head(0)
+        , tail(0)
+        , tid(threadId)
+        , orphaned(false)
+    {}
+
+    std::unique_ptr<char[]> data;
+    const size_t capacity;       // 2的幂
+    std::atomic<size_t> head;    // 消费者读到的位置，单调递增
+    std::atomic<size_t> tail;    // 生产者写到的位置，单调递增
+    const int tid;
+    std::atomic_bool orphaned;   // 所属线程已退出，读完后释放
+};
+
+class BinaryLog : noncopyable
+{
+public:
+    static BinaryLog& instance();
+
+    // 开始写到path，每个线程的环形缓冲区ringSize字节（向上取2的幂），后台线程每pollIntervalMs毫秒收集一次
+    bool start(const std::string &path, size_t ringSize = 1 << 20, int pollIntervalMs = 10);
+    // 写完已记录的数据后停止
+    void stop();
+    static bool started() { return started_.load(std::memory_order_acquire); }
+
+    // 环满被丢弃的记录数
+    uint64_t numDropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // 登记一个调用点，返回非0的id
+    uint32_t registerSite(LogLevel level, const char *file, int line, const char *fmt,
+                        const uint8_t *types, size_t nargs);
+
+    template <typename... Args>
+    static void log(std::atomic<uint32_t> *site, LogLevel level, const char *file, int line,
+                    const char *fmt, const Args&... args)
+    {
+        if(!started())
+        {
+            Logger::instance().log(level, fmt, args...);
+            return;
+        }
+        uint32_t id = site->load(std::memory_order_relaxed);
+        if(__builtin_expect(id == 0, 0))
+        {
+            const uint8_t types[] = { 0, blog::Arg<blog::Decayed<Args>>::kType... };
+            id = instance().registerSite(level, file, line, fmt, types + 1, sizeof...(Args));
+            site->store(id, std::memory_order_relaxed);
+        }
+
+        size_t size = blog::kRecordHeaderSize;
+        int sizes[] = { 0, (size += blog::Arg<blog::Decayed<Args>>::size(args), 0)... };
+        (void)sizes;
+        size = blog::align8(size);
+
+        char *p = reserve(size);
+        if(p == nullptr)
+        {
+            return;
+        }
+        uint32_t header[2] = { id, static_cast<uint32_t>(size) };
+        memcpy(p, header, 8);
+        int64_t now = nowMicros();
+        memcpy(p + 8, &now, 8);
+        p += blog::kRecordHeaderSize;
+        int encoded[] = { 0, (p = blog::Arg<blog::Decayed<Args>>::encode(p, args), 0)... };
+        (void)encoded;
+        commit(size);
+    }
+
+    // 只用于编译期检查格式串和参数类型，不会被调用
+    static void checkFormat(const char *, ...) __attribute__((format(printf, 1, 2))) {}
+
+private:
+    struct Site
+    {
+        uint32_t id;
+        LogLevel level;
+        int line;
+        std::string file;
+        std::string fmt;
+        std::vector<uint8_t> types;
+    };
+
+    BinaryLog();
+    ~BinaryLog();
+
+    static int64_t nowMicros();
+    // 在当前线程的环中预留size字节的连续空间，环满时返回nullptr
+    static char* reserve(size_t size);
+    static void commit(size_t size);
+    static BinaryLogRing* threadRing();
+
+    void threadFunc();
+    // 收集一轮，返回写出的字节数
+    size_t collect();
+    void writeSites();
+
+    static std::atomic_bool started_;
+
+    std::mutex mutex_; // 保护下面的sites_、rings_
+    std::vector<Site> sites_;
+    std::vector<std::shared_ptr<BinaryLogRing>> rings_;
+    size_t sitesWritten_; // 只在后台线程中访问
+
+    size_t ringSize_;
+    int pollIntervalMs_;
+    FILE *fp_;
+    std::unique_ptr<Thread> thread_;
+    std::atomic_bool running_;
+    std::atomic<uint64_t> dropped_;
+    uint64_t droppedWritten_;
+};
@@ -1,26 +1,63 @@
 #include "Buffer.h"
+#include "Trace.h"
 
 #include <errno.h>
+#include <string.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
 #include <unistd.h>
 
+// 和readv相同，另外从控制消息中取出软件接收时间戳
+static ssize_t readWithTimestamp(int fd, struct iovec *vec, int iovcnt, int64_t *rxMicros)
+{
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    *rxMicros = 0;
+    ssize_t n = ::recvmsg(fd, &msg, 0);
+    if(n > 0)
+    {
+        for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING)
+            {
+                struct scm_timestamping ts;
+                ::memcpy(&ts, CMSG_DATA(cm), sizeof ts);
+                // ts[0]是软件时间戳
+                *rxMicros = static_cast<int64_t>(ts.ts[0].tv_sec) * 1000 * 1000 + ts.ts[0].tv_nsec / 1000;
+            }
+        }
+    }
+    return n;
+}
+
 // 从fd上读数据, Poller工作在LT模式
 // Buffer缓冲区有大小！ 但从fd读数据时，不知道tcp数据最终大小
-ssize_t Buffer::readFd(int fd, int *saveErrno)
+ssize_t Buffer::readFd(int fd, int *saveErrno, size_t maxBytes, int64_t *rxMicros)
 {
     char extrabuf[65536] = {0}; // 栈上内存空间 64k
 
     struct iovec vec[2];
-    const size_t writeable = writeableBytes(); // 这是Buffer底层缓冲区剩余可写空间大小
+    // 这是Buffer底层缓冲区剩余可写空间大小，限速时不超过maxBytes
+    const size_t writeable = std::min(writeableBytes(), maxBytes);
     vec[0].iov_base = begin() + writerIndex_;
     vec[0].iov_len = writeable;
 
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof extrabuf;
+    vec[1].iov_len = std::min(sizeof extrabuf, maxBytes - writeable);
 
     // writable < sizeof extrabuf 表示底层可写的缓冲区空间不够大，用两块
-    const int iovcnt = (writeable < sizeof extrabuf) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt); // scatter input，分散读
+    const int iovcnt = (writeable < sizeof extrabuf && vec[1].iov_len > 0) ? 2 : 1;
+    const ssize_t n = rxMicros == nullptr
+                    ? ::readv(fd, vec, iovcnt) // scatter input，分散读
+                    : readWithTimestamp(fd, vec, iovcnt, rxMicros);
+    MYMUDUO_PROBE2(read, fd, n);
     if(n < 0)
     {
         *saveErrno = errno;
@@ -31,20 +68,26 @@ ssize_t Buffer::readFd(int fd, int *saveErrno)
     }
     else // extrabuf里面也写入了数据
     {
-        writerIndex_ = buffer_.size();
+        writerIndex_ += writeable;
         append(extrabuf, n - writeable);
     }
     return n;
 }
 
 // 通过fd发送数据
-ssize_t Buffer::writeFd(int fd, int *saveErrno)
+ssize_t Buffer::writeFd(int fd, int *saveErrno, size_t maxBytes)
 {
     // 可读的数据通过fd发出去
-    ssize_t n = ::write(fd, peek(), readableBytes());
+    size_t len = std::min(readableBytes(), maxBytes);
+    ssize_t n = ::write(fd, peek(), len);
+    MYMUDUO_PROBE2(write, fd, n);
     if(n < 0)
     {
         *saveErrno = errno;
+        if(errno == EAGAIN)
+        {
+            MYMUDUO_PROBE2(write_eagain, fd, len);
+        }
     }
     return n;
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <stdint.h>
+#include <sys/types.h>
 
 class Buffer
 {
@@ -31,6 +33,12 @@ public:
         return readerIndex_;
     }
 
+    // 底层vector已分配的容量
+    size_t internalCapacity() const
+    {
+        return buffer_.capacity();
+    }
+
     // 返回缓冲区可读数据起始地址
     const char* peek() const
     {
@@ -51,6 +59,12 @@ public:
         }
     }
 
+    // 撤销最后写入的len字节，len不能超过可读数据长度
+    void unwrite(size_t len)
+    {
+        writerIndex_ -= len;
+    }
+
     void retriveAll()
     {
         readerIndex_ = writerIndex_ = kCheapPrepend;
@@ -97,11 +111,12 @@ public:
         return begin() + writerIndex_;
     }
 
-    // 从fd上读数据
-    ssize_t readFd(int fd, int *saveErrno);
+    // 从fd上读数据，最多读maxBytes字节
+    // rxMicros非空时改用recvmsg，取出socket上SO_TIMESTAMPING记录的内核接收时间（微秒，CLOCK_REALTIME），没有时置0
+    ssize_t readFd(int fd, int *saveErrno, size_t maxBytes = SIZE_MAX, int64_t *rxMicros = nullptr);
 
-    // 通过fd发送数据
-    ssize_t writeFd(int fd, int *saveErrno);
+    // 通过fd发送数据，最多发maxBytes字节
+    ssize_t writeFd(int fd, int *saveErrno, size_t maxBytes = SIZE_MAX);
 
 private:
     char* begin()
@@ -3,10 +3,15 @@
 // 各类回调类型声明
 #include <memory>
 #include <functional>
+#include <string>
+
+#include "SocketOptions.h"
 
 class Buffer;
 class TcpConnection;
 class Timestamp;
+class TokenBucket;
+struct ConnectionMetrics;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
 using ConnectionCallback = std::function<void (const TcpConnectionPtr&)>;
@@ -16,3 +21,27 @@ using MessageCallback = std::function<void (const TcpConnectionPtr&,
                                             Buffer*,
                                             Timestamp)>;
 using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
+using TimerCallback = std::function<void()>;
+
+// 一组连接共享的回调表，由TcpServer在start()时创建，之后不再修改
+// 每个TcpConnection只持有指向它的shared_ptr，不再各自拷贝一份std::function
+struct TcpConnectionCallbacks
+{
+    std::string namePrefix; // 连接名前缀 name-ip:port
+    ConnectionCallback connectionCallback;
+    MessageCallback messageCallback;
+    WriteCompleteCallback writeCompleteCallback;
+    HighWaterMarkCallback highWaterMarkCallback;
+    CloseCallback closeCallback;
+
+    // 同一subLoop的连接共享的收发限速，只在该loop线程中使用，为空表示不限速
+    TokenBucket *sharedReadLimit = nullptr;
+    TokenBucket *sharedWriteLimit = nullptr;
+    // 同一subLoop的连接共享的指标，只在该loop线程中更新，为空表示不统计
+    ConnectionMetrics *metrics = nullptr;
+    // 是否记录每个请求各阶段的耗时，见ConnectionLatency
+    bool trackLatency = false;
+    // 连接socket的选项，在TcpConnection构造时设置
+    SocketOptions socketOptions;
+};
+using TcpConnectionCallbacksPtr = std::shared_ptr<const TcpConnectionCallbacks>;
@@ -1,15 +1,33 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "Timer.h"
+#include "Trace.h"
 
+#include <stdio.h>
 #include <sys/epoll.h>
 
 const int Channel::kNoneEvent = 0; 
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI; 
 const int Channel::kWriteEvent = EPOLLOUT;
 
+// 把std::function形式的回调适配为ChannelHandler
+class Channel::CallbackHandler : public ChannelHandler
+{
+public:
+    void handleRead(Timestamp receiveTime) override { if(readCallback) readCallback(receiveTime); }
+    void handleWrite() override { if(writeCallback) writeCallback(); }
+    void handleClose() override { if(closeCallback) closeCallback(); }
+    void handleError() override { if(errorCallback) errorCallback(); }
+
+    ReadEventCallback readCallback;
+    EventCallback writeCallback;
+    EventCallback closeCallback;
+    EventCallback errorCallback;
+};
+
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false), handler_(nullptr)
 {
 }
 
@@ -17,6 +35,21 @@ Channel::~Channel()
 {    
 }
 
+Channel::CallbackHandler& Channel::callbackHandler()
+{
+    if(!callbackHandler_)
+    {
+        callbackHandler_.reset(new CallbackHandler());
+        handler_ = callbackHandler_.get();
+    }
+    return *callbackHandler_;
+}
+
+void Channel::setReadCallback(ReadEventCallback cb) { callbackHandler().readCallback = std::move(cb); }
+void Channel::setWriteCallback(EventCallback cb) { callbackHandler().writeCallback = std::move(cb); }
+void Channel::setCloseCallback(EventCallback cb) { callbackHandler().closeCallback = std::move(cb); }
+void Channel::setErrorCallback(EventCallback cb) { callbackHandler().errorCallback = std::move(cb); }
+
 // ??channel的tie方法什么时候调用过
 void Channel::tie(const std::shared_ptr<void> &obj)
 {
@@ -41,53 +74,73 @@ void Channel::remove()
 // fd得到poller通知后处理事件
 void Channel::handleEvent(Timestamp receiveTime)
 {
+    // 开启了慢回调检测时计时；回调中Channel可能被销毁，之后只能用局部变量
+    int64_t threshold = loop_->slowCallbackMicros();
+    int64_t start = threshold > 0 ? Timer::now() : 0;
+    EventLoop *loop = loop_;
+    const int fd = fd_;
+    const int revents = revents_;
+    ChannelHandler *handler = handler_;
+    MYMUDUO_PROBE2(channel_enter, fd, revents);
+
     if(tied_) // 资源存活
     {
         std::shared_ptr<void> guard = tie_.lock();
         if(guard)
         {
             handleEventWithGuard(receiveTime);
+            // guard保证了handler还活着
+            int64_t elapsed = threshold > 0 ? Timer::now() - start : 0;
+            if(elapsed > threshold && handler != nullptr)
+            {
+                reportSlow(loop, fd, revents, handler->handlerName(), elapsed);
+            }
         }
     }
     else 
     {
         handleEventWithGuard(receiveTime);
+        int64_t elapsed = threshold > 0 ? Timer::now() - start : 0;
+        if(elapsed > threshold)
+        {
+            reportSlow(loop, fd, revents, std::string(), elapsed);
+        }
     }
+    MYMUDUO_PROBE1(channel_return, fd);
+}
+
+void Channel::reportSlow(EventLoop *loop, int fd, int revents, const std::string &name, int64_t micros)
+{
+    char buf[64] = {0};
+    snprintf(buf, sizeof buf, "fd=%d revents=%d", fd, revents);
+    loop->reportSlowCallback(name.empty() ? std::string(buf) : name + " " + buf, micros);
 }
 
 // 根据Poller通知的Channel发生的具体事件，调用相应的回调
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    LOG_DEBUG("channel handleEvent revents:%d\n", revents_);
+    if(handler_ == nullptr)
+    {
+        return;
+    }
     // EPOLLHUP 表示读写都关闭
     if((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
-        if(closeCallback_)
-        {
-            closeCallback_();
-        }
+        handler_->handleClose();
     }
     if(revents_ & EPOLLERR)
     {
-        if(errorCallback_)
-        {
-            errorCallback_();
-        }
+        handler_->handleError();
     }
     if(revents_ & (EPOLLIN | EPOLLPRI))
     {
-        if(readCallback_)
-        {
-            readCallback_(receiveTime);
-        }
+        handler_->handleRead(receiveTime);
     }
     
     if(revents_ & EPOLLOUT)
     {
-        if(writeCallback_)
-        {
-            writeCallback_();
-        }
+        handler_->handleWrite();
     }
 
 }
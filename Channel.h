@@ -5,11 +5,28 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 // 头文件中只给类的前置声明，而在源文件中再给出头文件包含
 // 因为源文件会被编程动态库.so, 减少对外暴露
 class EventLoop;
 
+// Channel上事件的处理接口，由fd的所有者（如TcpConnection）实现
+// Channel只保存一个指针，不必为每个fd保存四个std::function
+class ChannelHandler
+{
+public:
+    virtual void handleRead(Timestamp receiveTime) = 0;
+    virtual void handleWrite() = 0;
+    virtual void handleClose() = 0;
+    virtual void handleError() = 0;
+    // 慢回调检测时用来标识是谁，只在回调超时时调用
+    virtual std::string handlerName() const { return std::string(); }
+
+protected:
+    ~ChannelHandler() = default;
+};
+
 // EventLoop包含多个Channel 和 Poller
 // Channel对应Reactor上的 Demultiplex （多路复用器）
 // !!!一个channel对应唯一EventLoop，一个EventLoop可以有多个channel
@@ -28,10 +45,15 @@ public:
     // fd得到poller通知后调用其处理事件
     void handleEvent(Timestamp recevieTime);
 
-    void setReadCallback(ReadEventCallback cb) { readCallback_ = std::move(cb); }
-    void setWriteCallback(EventCallback cb) { writeCallback_ = std::move(cb); }
-    void setCloseCallback(EventCallback cb) { closeCallback_ = std::move(cb); }
-    void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
+    // 事件直接分发给handler，handler的生命期由调用者保证（通常就是Channel的所有者）
+    void setHandler(ChannelHandler *handler) { handler_ = handler; }
+
+    // 以std::function的形式设置回调，内部按需创建一个CallbackHandler
+    // 适合Acceptor、wakeupChannel这类数量很少的Channel
+    void setReadCallback(ReadEventCallback cb);
+    void setWriteCallback(EventCallback cb);
+    void setCloseCallback(EventCallback cb);
+    void setErrorCallback(EventCallback cb);
 
     // 防止当Channel的所有者被手动remove掉时，Channel 仍在执行回调
     void tie(const std::shared_ptr<void>&); // 检测资源存活状态
@@ -63,9 +85,13 @@ public:
     void remove();
 
 private:
+    class CallbackHandler;
+    CallbackHandler& callbackHandler();
 
     void update();
     void handleEventWithGuard(Timestamp recvTime);
+    // 回调超过loop的慢回调阈值时记录，Channel此时可能已被销毁，只用传入的值
+    static void reportSlow(EventLoop *loop, int fd, int revents, const std::string &name, int64_t micros);
 
     static const int kNoneEvent; // 感兴趣的事件类型，该变量表示不感兴趣任何事件
     static const int kReadEvent; 
@@ -81,10 +107,8 @@ private:
     bool tied_;
 
     // 因为Channel里能得知fd最终发生的具体事件revents_
-    // 故它负责调用对应的回调
-    ReadEventCallback readCallback_;
-    EventCallback writeCallback_;
-    EventCallback closeCallback_;
-    EventCallback errorCallback_;
+    // 故它负责调用handler_上对应的处理函数
+    ChannelHandler *handler_;
+    std::unique_ptr<CallbackHandler> callbackHandler_; // 仅使用setXxxCallback时创建
 
 };
\ No newline at end of file
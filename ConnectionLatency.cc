@@ -0,0 +1,13 @@
+#include "ConnectionLatency.h"
+
+const char* ConnectionLatency::phaseName(int phase)
+{
+    static const char *kNames[kNumPhases] = {
+        "kernel_to_poll",
+        "poll_to_read",
+        "callback",
+        "output_queued",
+        "write_complete",
+    };
+    return phase >= 0 && phase < kNumPhases ? kNames[phase] : "unknown";
+}
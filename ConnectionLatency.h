@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// 一个请求在服务器内的各阶段耗时，时间都是CLOCK_REALTIME微秒，和EventLoop的pollReturnTime一致
+// 以一次可读事件为一个请求：
+//   kKernelToPoll   内核收到数据（SO_TIMESTAMPING）到epoll_wait返回
+//   kPollToRead     epoll_wait返回到开始handleRead，即同一轮中排在前面的Channel占用的时间
+//   kCallback       messageCallback的执行时间
+//   kOutputQueued   数据在outputBuffer_中等待内核发送缓冲区腾出空间的时间
+//   kWriteComplete  epoll_wait返回到这次回调产生的数据全部交给内核，即writeCompleteCallback的时机
+struct ConnectionLatency
+{
+    enum Phase
+    {
+        kKernelToPoll,
+        kPollToRead,
+        kCallback,
+        kOutputQueued,
+        kWriteComplete,
+        kNumPhases,
+    };
+
+    static const char* phaseName(int phase);
+
+    struct Stat
+    {
+        Stat() : count(0), sumMicros(0), maxMicros(0), lastMicros(0) {}
+        void add(int64_t micros)
+        {
+            ++count;
+            sumMicros += micros;
+            maxMicros = micros > maxMicros ? micros : maxMicros;
+            lastMicros = micros;
+        }
+        double avgMicros() const { return count == 0 ? 0.0 : static_cast<double>(sumMicros) / count; }
+
+        uint64_t count;
+        int64_t sumMicros;
+        int64_t maxMicros;
+        int64_t lastMicros;
+    };
+
+    ConnectionLatency() : requestStart(0), queuedSince(0), sent(false) {}
+
+    Stat stats[kNumPhases];
+
+    // 下面是进行中的请求的状态，由TcpConnection维护
+    int64_t requestStart; // 等待outputBuffer_发完的请求的pollReturnTime，0表示没有
+    int64_t queuedSince;  // outputBuffer_从空变为非空的时间，0表示为空
+    bool sent;            // 本次回调中是否发送过数据
+};
@@ -0,0 +1,254 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+const int Connector::kInitRetryDelayMs;
+const int Connector::kMaxRetryDelayMs;
+
+static int createNonblocking(sa_family_t family)
+{
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d connect socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static int getSocketError(int sockfd)
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    if(::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+// 连接本机上未监听的端口时，内核可能把临时端口分配成目标端口，自己连上自己（只有TCP会出现）
+static bool isSelfConnect(int sockfd)
+{
+    sockaddr_in local, peer;
+    ::bzero(&local, sizeof local);
+    ::bzero(&peer, sizeof peer);
+    socklen_t len = sizeof local;
+    ::getsockname(sockfd, (sockaddr*)&local, &len);
+    len = sizeof peer;
+    ::getpeername(sockfd, (sockaddr*)&peer, &len);
+    return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , retryDelayMs_(kInitRetryDelayMs)
+{
+}
+
+Connector::~Connector()
+{
+    if(channel_)
+    {
+        LOG_ERROR("%s:%s:%d connector destroyed while connecting \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = kInitRetryDelayMs;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->runInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if(connect_ && state_ == kDisconnected)
+    {
+        connect();
+    }
+}
+
+void Connector::stopInLoop()
+{
+    loop_->cancel(retryTimer_);
+    if(state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    // 例如fromUnixPath的路径过长，重试也不会成功
+    if(!serverAddr_.valid())
+    {
+        LOG_ERROR("%s:%s:%d invalid server address \n", __FILE__, __FUNCTION__, __LINE__);
+        fail(-1, EINVAL);
+        return;
+    }
+    int sockfd = createNonblocking(serverAddr_.family());
+    int ret = ::connect(sockfd, serverAddr_.sockAddr(), serverAddr_.sockAddrLen());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch(savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    // 对端暂时不可达，稍后重试
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENOENT: // Unix域socket文件还没创建
+    case ENETUNREACH:
+    case ETIMEDOUT:
+        retry(sockfd);
+        break;
+
+    default:
+        LOG_ERROR("%s:%s:%d connect %s error:%d \n", __FILE__, __FUNCTION__, __LINE__,
+            serverAddr_.toIpPort().c_str(), savedErrno);
+        fail(sockfd, savedErrno);
+        break;
+    }
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    // connect完成（成功或失败）时socket变为可写
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 当前可能正处于channel_的事件回调中，不能在这里销毁它
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if(state_ != kConnecting)
+    {
+        return;
+    }
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if(err)
+    {
+        LOG_ERROR("Connector::handleWrite %s SO_ERROR:%d \n", serverAddr_.toIpPort().c_str(), err);
+        retry(sockfd);
+    }
+    else if(!serverAddr_.isUnix() && isSelfConnect(sockfd))
+    {
+        LOG_ERROR("Connector::handleWrite %s self connect \n", serverAddr_.toIpPort().c_str());
+        retry(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if(connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if(state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        LOG_ERROR("Connector::handleError %s SO_ERROR:%d \n", serverAddr_.toIpPort().c_str(), getSocketError(sockfd));
+        retry(sockfd);
+    }
+}
+
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if(connect_)
+    {
+        LOG_INFO("Connector::retry connecting to %s in %d ms \n", serverAddr_.toIpPort().c_str(), retryDelayMs_);
+        std::weak_ptr<Connector> weakSelf(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weakSelf]() {
+            std::shared_ptr<Connector> self = weakSelf.lock();
+            if(self)
+            {
+                self->startInLoop();
+            }
+        });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+    }
+}
+
+void Connector::fail(int sockfd, int err)
+{
+    if(sockfd >= 0)
+    {
+        ::close(sockfd);
+    }
+    setState(kDisconnected);
+    // connect()可能在start()中同步执行，放到本轮回调之后通知，避免上层在回调中重入
+    if(connect_ && connectFailedCallback_)
+    {
+        loop_->queueInLoop(std::bind(&Connector::handleConnectFailed, shared_from_this(), err));
+    }
+}
+
+void Connector::handleConnectFailed(int err)
+{
+    // 排队期间可能已经被stop()
+    if(connect_ && connectFailedCallback_)
+    {
+        connect_ = false;
+        connectFailedCallback_(err);
+    }
+}
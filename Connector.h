@@ -0,0 +1,72 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class Channel;
+class EventLoop;
+
+// 主动发起连接，与Acceptor相对：Acceptor被动accept得到connfd，Connector主动connect得到sockfd
+// 非阻塞connect，EINPROGRESS时通过Channel等待socket可写再检查SO_ERROR
+// 连接失败后按指数退避重试，重试的等待由loop的定时器完成，不阻塞loop线程
+// 只负责建立socket连接，连接建立后把sockfd交给上层（TcpClient）创建TcpConnection
+class Connector : noncopyable,
+                  public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+    // 不可重试的connect错误（权限、地址族不支持等），Connector已停止，参数为errno
+    using ConnectFailedCallback = std::function<void(int err)>;
+
+    static const int kInitRetryDelayMs = 500;       // 第一次重试的等待
+    static const int kMaxRetryDelayMs = 30 * 1000;  // 退避的上限
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    void setConnectFailedCallback(const ConnectFailedCallback &cb) { connectFailedCallback_ = cb; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    // 可在任意线程调用
+    void start();
+    void stop();
+    // 连接断开后重新连接，必须在loop线程中调用，重试等待恢复为初始值
+    void restart();
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    // 等待非阻塞connect完成
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    // 关闭sockfd，稍后重试
+    void retry(int sockfd);
+    // 关闭sockfd（还没创建时为-1），不再重试，通知上层
+    void fail(int sockfd, int err);
+    void handleConnectFailed(int err);
+    // 把channel_从Poller上摘掉，返回其fd
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_; // 用户是否希望保持连接
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_; // 只在connect进行中存在
+    NewConnectionCallback newConnectionCallback_;
+    ConnectFailedCallback connectFailedCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
@@ -0,0 +1,206 @@
+#include "CpuPlacement.h"
+#include "Logger.h"
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+
+namespace
+{
+    // 与<numaif.h>一致，直接走系统调用，不依赖libnuma
+    const int kMpolPreferred = 1;
+    const int kMaxNodes = 1024;
+
+    std::string readLine(const std::string &path)
+    {
+        std::string line;
+        FILE *fp = ::fopen(path.c_str(), "r");
+        if(fp != nullptr)
+        {
+            char buf[256] = {0};
+            if(::fgets(buf, sizeof buf, fp) != nullptr)
+            {
+                line = buf;
+            }
+            ::fclose(fp);
+        }
+        return line;
+    }
+
+    std::vector<int> siblingsOf(int cpu)
+    {
+        char path[96] = {0};
+        snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        std::vector<int> siblings = CpuPlacement::parseCpuList(readLine(path));
+        if(siblings.empty())
+        {
+            // 没有拓扑信息时把每个逻辑CPU当作一个物理核
+            siblings.push_back(cpu);
+        }
+        return siblings;
+    }
+}
+
+std::vector<int> CpuPlacement::allowedCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(::sched_getaffinity(0, sizeof set, &set) < 0)
+    {
+        LOG_ERROR("CpuPlacement::allowedCpus sched_getaffinity errno:%d \n", errno);
+        return cpus;
+    }
+    for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if(CPU_ISSET(cpu, &set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> CpuPlacement::physicalCores(const std::vector<int> &reserved)
+{
+    std::vector<int> allowed = allowedCpus();
+    std::vector<int> cores;
+    for(int cpu : allowed)
+    {
+        bool take = true;
+        for(int sibling : siblingsOf(cpu))
+        {
+            // 保留CPU的超线程兄弟也不用，否则会和保留的工作抢同一个物理核
+            if(std::find(reserved.begin(), reserved.end(), sibling) != reserved.end())
+            {
+                take = false;
+                break;
+            }
+            // 同一物理核只取编号最小的那个允许的逻辑CPU
+            if(sibling < cpu && std::binary_search(allowed.begin(), allowed.end(), sibling))
+            {
+                take = false;
+                break;
+            }
+        }
+        if(take)
+        {
+            cores.push_back(cpu);
+        }
+    }
+    return cores;
+}
+
+std::vector<int> CpuPlacement::parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    const char *p = list.c_str();
+    while(*p != '\0')
+    {
+        char *end = nullptr;
+        long first = ::strtol(p, &end, 10);
+        if(end == p)
+        {
+            break;
+        }
+        long last = first;
+        p = end;
+        if(*p == '-')
+        {
+            last = ::strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for(long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+        {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if(*p != ',')
+        {
+            break;
+        }
+        ++p;
+    }
+    return cpus;
+}
+
+int CpuPlacement::nodeOfCpu(int cpu)
+{
+    // cpuN目录下有一个指向所属节点的 nodeM 链接
+    char path[64] = {0};
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = ::opendir(path);
+    if(dir == nullptr)
+    {
+        return -1;
+    }
+    int node = -1;
+    while(struct dirent *entry = ::readdir(dir))
+    {
+        int n = 0;
+        if(::sscanf(entry->d_name, "node%d", &n) == 1)
+        {
+            node = n;
+            break;
+        }
+    }
+    ::closedir(dir);
+    return node;
+}
+
+bool CpuPlacement::bindCurrentThread(int cpu)
+{
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        LOG_ERROR("CpuPlacement::bindCurrentThread invalid cpu %d \n", cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+    if(err != 0)
+    {
+        LOG_ERROR("CpuPlacement::bindCurrentThread cpu %d errno:%d \n", cpu, err);
+        return false;
+    }
+
+    // 单节点机器上默认策略已经是本地分配；显式设置是为了覆盖numactl --interleave等继承来的策略
+    int node = nodeOfCpu(cpu);
+    if(node >= 0 && node < kMaxNodes)
+    {
+        const int kBitsPerLong = 8 * sizeof(unsigned long);
+        unsigned long mask[kMaxNodes / kBitsPerLong] = {0};
+        mask[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong);
+        // 内核按 maxnode-1 位解析掩码
+        if(::syscall(SYS_set_mempolicy, kMpolPreferred, mask, static_cast<unsigned long>(kMaxNodes + 1)) < 0)
+        {
+            LOG_INFO("CpuPlacement::bindCurrentThread set_mempolicy node %d errno:%d \n", node, errno);
+        }
+    }
+    LOG_INFO("CpuPlacement::bindCurrentThread tid %d -> cpu %d node %d \n", CurrentThread::tid(), cpu, node);
+    return true;
+}
+
+int CpuPlacement::incomingCpu(int sockfd)
+{
+    int cpu = -1;
+    socklen_t len = static_cast<socklen_t>(sizeof cpu);
+    if(::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+    {
+        return -1;
+    }
+    return cpu;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// loop线程的CPU绑定和NUMA内存放置，拓扑信息来自 /sys/devices/system/cpu
+// 1. physicalCores() 在进程允许的CPU中（sched_getaffinity，已考虑taskset/cgroup）每个物理核取一个逻辑CPU，
+//    跳过超线程兄弟；reserved中的CPU所在的整个物理核都不用，一般留给baseLoop、网卡中断或其他进程
+// 2. bindCurrentThread() 把当前线程绑定到一个CPU，并把内存策略设为优先该CPU所在的NUMA节点，
+//    之后本线程首次写入的页都落在该节点上；loop线程在创建EventLoop之前绑定，
+//    TcpConnectionPool、连接的Buffer、epoll事件数组等都在loop线程中分配，因此都是节点本地内存
+// 3. incomingCpu() 读取SO_INCOMING_CPU，即最近处理该socket收包软中断的CPU，
+//    网卡RSS/IRQ亲和性与loop的CPU对齐时，TcpServer据此把连接交给同一CPU上的loop
+class CpuPlacement
+{
+public:
+    // 进程当前允许运行的CPU，升序
+    static std::vector<int> allowedCpus();
+    // 每个物理核一个逻辑CPU，按CPU编号升序，不含reserved所在的物理核
+    static std::vector<int> physicalCores(const std::vector<int> &reserved = std::vector<int>());
+    // 解析 "0-3,8,10-11" 形式的CPU列表
+    static std::vector<int> parseCpuList(const std::string &list);
+    // CPU所在的NUMA节点，没有NUMA信息时返回-1
+    static int nodeOfCpu(int cpu);
+
+    // 把当前线程绑定到cpu，并优先从其NUMA节点分配内存，绑定失败返回false
+    static bool bindCurrentThread(int cpu);
+
+    // 处理该socket收包的CPU，未知时返回-1
+    static int incomingCpu(int sockfd);
+};
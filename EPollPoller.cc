@@ -33,7 +33,7 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    LOG_INFO("func = %s => fd total count : %lu \n", __FUNCTION__, channels_.size());
+    LOG_DEBUG("func = %s => fd total count : %lu \n", __FUNCTION__, channels_.size());
 
     // 
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
@@ -42,7 +42,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 
     if(numEvents > 0)
     {
-        LOG_INFO("%d events happened \n", numEvents);
+        LOG_DEBUG("%d events happened \n", numEvents);
         // 将活跃(有事件发生的)Channel添加到activeChannels中
         fillActiveChannels(numEvents, activeChannels);
         if(numEvents == events_.size()) // 扩容
@@ -73,7 +73,7 @@ void EPollPoller::updateChannel(Channel *channel)
 {
     // index() 得出channel状态，即kNew or kAdded or kDeleted
     const int index = channel->index();
-    LOG_INFO("func = %s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
+    LOG_DEBUG("func = %s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
 
     if(index == kNew || index == kDeleted)
     {
@@ -107,7 +107,7 @@ void EPollPoller::removeChannel(Channel *channel)
     int fd = channel->fd();
     channels_.erase(fd); // 从ChannelMap中删除，成为kNew
 
-    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
 
     int index = channel->index();
     if(index == kAdded) 
@@ -2,16 +2,37 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "Timer.h"
+#include "TimerQueue.h"
+#include "Trace.h"
+#include "PerfCounters.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cxxabi.h>
 
 // 每个线程都有自己独立的一份拷贝 thread_local
 __thread EventLoop *t_loopInThisThread = nullptr;
 
+// 把回调对象的类型名还原成可读的形式，失败时原样返回
+static std::string demangle(const char *name)
+{
+    int status = 0;
+    char *readable = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if(status != 0 || readable == nullptr)
+    {
+        return name;
+    }
+    std::string result(readable);
+    ::free(readable);
+    return result;
+}
+
 // 定义默认Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000;
 
@@ -33,9 +54,13 @@ EventLoop::EventLoop()
     , quit_(false)
     , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid()) // 当前loop的线程是构造时的线程
+    , busySince_(0)
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , slowCallbackMicros_(0)
+    , perf_(nullptr)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
     if(t_loopInThisThread)
@@ -52,10 +77,14 @@ EventLoop::EventLoop()
     // 每个eventloop都将监听wakeupchannel_的EPOLLIN读事件
     // 等待被唤醒
     wakeupChannel_->enableReading();
+
+    metricsId_ = MetricsRegistry::instance().add(std::bind(&EventLoop::collectMetrics, this, std::placeholders::_1));
 }
 
 EventLoop::~EventLoop()
 {
+    MetricsRegistry::instance().remove(metricsId_);
+    delete perf_.load();
     wakeupChannel_->disableAll(); // 对所有事件不感兴趣
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -69,25 +98,52 @@ void EventLoop::loop()
 
     LOG_INFO("EventLoop %p start looping \n", this);
 
+    int64_t busyStart = Timer::now();
     while(!quit_)
     {
+        PerfCounters *perf = perf_.load(std::memory_order_relaxed);
+        bool perfSampled = perf != nullptr && perf->beginIteration();
         activeChannels_.clear();
+        busySince_.store(0, std::memory_order_relaxed);
+        int64_t pollStart = Timer::now();
+        metrics_.busyMicros.add(pollStart - busyStart);
         // 监听两类fd，一种时clientfd，一种是wakeupfd(main reactor 和 sub reactor通信用)
         // 发生事件的Channel都被加入到 activeChannels_  中
+        MYMUDUO_PROBE1(poll_enter, this);
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        MYMUDUO_PROBE2(poll_return, this, activeChannels_.size());
+        if(perfSampled)
+        {
+            perf->endPhase(PerfCounters::kPoll);
+        }
+        busyStart = Timer::now();
+        busySince_.store(busyStart, std::memory_order_relaxed);
+        metrics_.blockedMicros.add(busyStart - pollStart);
+        metrics_.polls.increment();
+        metrics_.events.add(activeChannels_.size());
+        metrics_.eventsPerPoll.observe(activeChannels_.size());
         for(Channel *channel : activeChannels_)
         {
             // Poller监听哪些Channel发生事件，上报给EventLoop，通知Channel处理相应事件
             channel->handleEvent(pollReturnTime_);
         }
+        if(perfSampled)
+        {
+            perf->endPhase(PerfCounters::kDispatch);
+        }
 
         // 执行当前EventLoop 事件循环需要处理的回调操作
         // IO线程 mainLoop accept fd 然后将连接fd对应的channel传递到 subloop
         // mainLoop事先注册回调cb（需要subloop所在线程中执行）
         // 通过 wakeupChannel_唤醒 subloop后 执行mainLoop事先注册回调cb
         doPendingFunctors();
+        if(perfSampled)
+        {
+            perf->endPhase(PerfCounters::kFunctors);
+        }
     }
 
+    busySince_.store(0, std::memory_order_relaxed);
     LOG_INFO("EventLoop %p stop looping. \n", this);
     looping_ = false;
 }
@@ -112,16 +168,20 @@ void EventLoop::runInLoop(Functor cb)
     }
     else // 在非当前loop线程中执行cb，需要唤醒loop所在线程，执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 // 把cb放入队列中，唤醒loop操作（epoll_wait）所在线程执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
+    size_t depth = 0;
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb); // emplace_back减少拷贝开销
+        pendingFunctors_.emplace_back(std::move(cb)); // 移动进队列，避免再拷贝一次回调对象
+        depth = pendingFunctors_.size();
     }
+    MYMUDUO_PROBE2(functor_queue, this, depth);
+    (void)depth;
 
     // 唤醒相应的，需要执行上面回调操作的loop线程
     // || callingPendingFunctors_ 表示： 当前loop正在执行回调，但是loop有了新的回调
@@ -141,6 +201,29 @@ void EventLoop::handleRead()
     }
 }
 
+int64_t EventLoop::lagMicros() const
+{
+    int64_t since = busySince_.load(std::memory_order_relaxed);
+    return since == 0 ? 0 : Timer::now() - since;
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    int64_t when = Timer::now() + static_cast<int64_t>(delay * Timer::kMicroSecondsPerSecond);
+    return timerQueue_->addTimer(std::move(cb), when, 0.0);
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    int64_t when = Timer::now() + static_cast<int64_t>(interval * Timer::kMicroSecondsPerSecond);
+    return timerQueue_->addTimer(std::move(cb), when, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 用来唤醒loop所在线程,也就是向wakeupfd_写8 bytes 数据
 // wakeupChannel就发生读事件，当前loop线程就会被唤醒
 void EventLoop::wakeup()
@@ -179,10 +262,96 @@ void EventLoop::doPendingFunctors()
         // 使得EventLoop::queueInLoop中往 pendingFunctors_ 加入回调不用等待这一批回调执行完就可加入
         functors.swap(pendingFunctors_);
     }
+    MYMUDUO_PROBE2(functor_dequeue, this, functors.size());
 
+    int64_t threshold = slowCallbackMicros();
+    int64_t start = threshold > 0 ? Timer::now() : 0;
     for(const Functor &functor : functors)
     {
         functor(); // 执行当前loop需要执行的回调
+        if(threshold > 0)
+        {
+            int64_t end = Timer::now();
+            if(end - start > threshold)
+            {
+                reportSlowCallback(std::string("functor ") + demangle(functor.target_type().name()), end - start);
+            }
+            start = end;
+        }
     }
     callingPendingFunctors_ = false;
+    metrics_.functors.add(functors.size());
+    metrics_.functorsPerBatch.observe(functors.size());
+}
+
+void EventLoop::enablePerfCounters(int sampleEvery)
+{
+    // perf_event_open只统计调用线程，必须在loop线程中打开
+    runInLoop([this, sampleEvery]() {
+        if(perf_.load() != nullptr)
+        {
+            return;
+        }
+        std::unique_ptr<PerfCounters> perf(new PerfCounters(sampleEvery));
+        if(perf->open())
+        {
+            perf_.store(perf.release(), std::memory_order_release);
+        }
+    });
+}
+
+void EventLoop::setSlowCallbackThreshold(double threshold)
+{
+    slowCallbackMicros_.store(static_cast<int64_t>(threshold * Timer::kMicroSecondsPerSecond), std::memory_order_relaxed);
+}
+
+void EventLoop::reportSlowCallback(const std::string &what, int64_t micros)
+{
+    metrics_.slowCallbacks.increment();
+    LOG_ERROR("EventLoop %p slow callback %s took %lld us \n", this, what.c_str(), static_cast<long long>(micros));
+}
+
+// 在抓取指标的线程中调用，计数器可以直接读，队列长度要加锁
+void EventLoop::collectMetrics(MetricsWriter &writer)
+{
+    char buf[32] = {0};
+    snprintf(buf, sizeof buf, "loop=\"%d\"", threadId_);
+    std::string labels(buf);
+
+    writer.counter("mymuduo_loop_polls_total", "Number of epoll_wait calls.", labels, metrics_.polls.value());
+    writer.counter("mymuduo_loop_events_total", "Number of events returned by epoll_wait.", labels, metrics_.events.value());
+    MetricsWriter::HistogramSnapshot events;
+    events.add(metrics_.eventsPerPoll);
+    writer.histogram("mymuduo_loop_events_per_poll", "Events returned by one epoll_wait.", labels, events);
+    writer.counter("mymuduo_loop_blocked_microseconds_total", "Time spent blocked in epoll_wait.", labels, metrics_.blockedMicros.value());
+    writer.counter("mymuduo_loop_busy_microseconds_total", "Time spent handling events and functors.", labels, metrics_.busyMicros.value());
+    writer.counter("mymuduo_loop_functors_total", "Number of queued functors executed.", labels, metrics_.functors.value());
+    MetricsWriter::HistogramSnapshot batch;
+    batch.add(metrics_.functorsPerBatch);
+    writer.histogram("mymuduo_loop_functors_per_batch", "Functors executed by one doPendingFunctors.", labels, batch);
+    writer.counter("mymuduo_loop_slow_callbacks_total", "Callbacks that ran longer than the slow callback threshold.", labels, metrics_.slowCallbacks.value());
+    PerfCounters *perf = perf_.load(std::memory_order_acquire);
+    if(perf != nullptr)
+    {
+        writer.counter("mymuduo_loop_perf_sampled_iterations_total", "Loop iterations sampled with perf counters.", labels, perf->sampledIterations());
+        for(int event = 0; event < PerfCounters::kNumEvents; ++event)
+        {
+            if(!perf->available(event))
+            {
+                continue;
+            }
+            std::string name = std::string("mymuduo_loop_perf_") + PerfCounters::eventName(event) + "_total";
+            for(int phase = 0; phase < PerfCounters::kNumPhases; ++phase)
+            {
+                writer.counter(name.c_str(), "Hardware/software perf counter accumulated over sampled iterations, by loop phase.",
+                    labels + ",phase=\"" + PerfCounters::phaseName(phase) + "\"", perf->value(phase, event));
+            }
+        }
+    }
+    size_t pending = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending = pendingFunctors_.size();
+    }
+    writer.gauge("mymuduo_loop_pending_functors", "Functors waiting in the queue.", labels, static_cast<int64_t>(pending));
 }
\ No newline at end of file
@@ -5,13 +5,19 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <string>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "Metrics.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
+class PerfCounters;
 
 // 事件循环类： 负责 Channel Poller（epoll抽象）
 class EventLoop : noncopyable
@@ -29,11 +35,40 @@ public:
 
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    // 本轮事件处理已经持续的微秒数，loop阻塞在epoll_wait中时为0
+    // 可在其他线程调用，用来判断loop是否处理不过来
+    int64_t lagMicros() const;
+
+    // 本loop的运行指标，已登记到MetricsRegistry，标签为 loop="线程tid"
+    const LoopMetrics& metrics() const { return metrics_; }
+
+    // 慢回调检测：单个Channel事件回调或queueInLoop的回调执行超过threshold秒时，
+    // 记一条ERROR日志（带连接名和耗时）并计入指标，0表示关闭（默认），可在任意线程调用
+    void setSlowCallbackThreshold(double threshold);
+    int64_t slowCallbackMicros() const { return slowCallbackMicros_.load(std::memory_order_relaxed); }
+    // 记录一次慢回调，只在loop线程中调用
+    void reportSlowCallback(const std::string &what, int64_t micros);
+
+    // 为loop线程打开硬件性能计数器，每sampleEvery轮循环按阶段（poll/dispatch/functors）采样一次，
+    // 结果和loop的其他指标一起导出；perf事件不可用时记一条INFO日志后忽略，可在任意线程调用
+    // EventLoopThread按PerfCounters::setDefaultSampleEvery()的设置自动打开
+    void enablePerfCounters(int sampleEvery = 64);
+
+    // loop所在线程的tid
+    pid_t threadId() const { return threadId_; }
+
     // 在当前loop中执行cb
     void runInLoop(Functor cb);
     // 把cb放入队列中，唤醒loop操作（epoll_wait）所在线程执行cb
     void queueInLoop(Functor cb);
 
+    // 定时器，线程安全。delay/interval单位为秒，使用单调时钟
+    // delay秒后在loop线程中执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒在loop线程中执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    void cancel(TimerId timerId);
+
     // 用来唤醒loop所在线程
     void wakeup();
 
@@ -48,6 +83,7 @@ public:
 private:
     void handleRead(); // 唤醒
     void doPendingFunctors(); // 执行回调
+    void collectMetrics(MetricsWriter &writer);
 
     using ChannelList = std::vector<Channel*>;
 
@@ -58,7 +94,9 @@ private:
     const pid_t threadId_; // 记录当前EventLoop进行loop操作所在线程的tid，确保Channel回调在其对应的evnetloop中执行 
 
     Timestamp pollReturnTime_; // poller返回发生事件的channels的时间点
+    std::atomic<int64_t> busySince_; // 本轮poll返回的单调时钟时间，阻塞在poll中时为0
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_;
 
     int wakeupFd_; // 主要作用：当mainloop获取一个新用户的channel，通过轮询算法选择一个subloop，通过该fd唤醒对应subloop来执行Channel回调
     std::unique_ptr<Channel> wakeupChannel_; // 别的线程唤醒本loop线程使用的Channel
@@ -69,4 +107,9 @@ private:
     std::vector<Functor> pendingFunctors_; // 存储loop需要执行的所有回调函数
     std::mutex mutex_; // 保护 pendingFunctors_ 线程安全操作
 
+    std::atomic<int64_t> slowCallbackMicros_; // 0表示不检测
+    std::atomic<PerfCounters*> perf_; // 在loop线程中创建，抓取指标的线程只读，析构时释放
+    LoopMetrics metrics_;
+    uint64_t metricsId_;
+
 };
\ No newline at end of file
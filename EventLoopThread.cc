@@ -1,5 +1,7 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "PerfCounters.h"
+#include "CpuPlacement.h"
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
         const std::string &name)
@@ -9,6 +11,7 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
         , mutex_()
         , cond_()
         , callback_(cb)
+        , cpu_(-1)
 {
 
 }
@@ -41,10 +44,20 @@ EventLoop* EventLoopThread::startLoop()
 // 在单独的新线程里运行，即thread_.start()内的func()
 void EventLoopThread::threadFunc()
 {
+    // 先绑定CPU和NUMA节点，EventLoop及之后在本线程分配的内存都落在该节点上
+    if(cpu_ >= 0)
+    {
+        CpuPlacement::bindCurrentThread(cpu_);
+    }
+
     // 创建一个独立的eventloop，和上面线程一一对应
     // one loop per thread
     // 栈上分配
     EventLoop loop; 
+    if(PerfCounters::defaultSampleEvery() > 0)
+    {
+        loop.enablePerfCounters(PerfCounters::defaultSampleEvery());
+    }
 
     if(callback_)
     {
@@ -19,6 +19,9 @@ public:
         const std::string &name = std::string());
     ~EventLoopThread();
 
+    // 线程启动后、创建EventLoop之前把自己绑定到cpu（见CpuPlacement），-1表示不绑定，须在startLoop()之前设置
+    void setCpu(int cpu) { cpu_ = cpu; }
+
     EventLoop* startLoop();
 private:
     void threadFunc(); // 线程的执行函数
@@ -29,4 +32,5 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_; // 用于线程初始化的回调
+    int cpu_;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "CpuPlacement.h"
+#include "Logger.h"
 
 #include <memory>
 
@@ -9,6 +11,7 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
     , started_(false)
     , numThreads_(0)
     , next_(0)
+    , autoAffinity_(false)
 {
 
 }
@@ -20,14 +23,42 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
 
+    if(autoAffinity_ && numThreads_ > 0)
+    {
+        cpus_ = CpuPlacement::physicalCores(reservedCpus_);
+        if(cpus_.empty())
+        {
+            LOG_ERROR("EventLoopThreadPool::start [%s] no cpu left after reserving, loops are not pinned \n", name_.c_str());
+        }
+        else if(cpus_.size() < static_cast<size_t>(numThreads_))
+        {
+            LOG_INFO("EventLoopThreadPool::start [%s] %d loops on %lu physical cores \n",
+                name_.c_str(), numThreads_, cpus_.size());
+        }
+    }
+
     for(int i = 0; i < numThreads_; ++i)
     {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
         //
         EventLoopThread *t = new EventLoopThread(cb, buf);
+        int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+        t->setCpu(cpu);
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop()); // 底层创建线程，绑定一个新的EventLoop，并返回该Loop地址
+        loopCpus_.push_back(cpu);
+        if(cpu >= 0)
+        {
+            if(static_cast<size_t>(cpu) >= loopByCpu_.size())
+            {
+                loopByCpu_.resize(cpu + 1, nullptr);
+            }
+            if(loopByCpu_[cpu] == nullptr)
+            {
+                loopByCpu_[cpu] = loops_.back();
+            }
+        }
     }
 
     // 整个服务器只有一个线程，运行baseLoop
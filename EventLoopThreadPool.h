@@ -19,6 +19,17 @@ public:
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
 
+    // loop线程的CPU绑定，须在start()之前设置，不设置时不绑定；baseLoop所在线程由用户自己决定，不在此绑定
+    // 第i个subLoop绑定到cpus[i % cpus.size()]
+    void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; autoAffinity_ = false; }
+    // start()时按CpuPlacement::physicalCores()自动选CPU：每个物理核一个loop，跳过超线程兄弟和reserved所在的物理核
+    // subLoop比物理核多时从头循环
+    void setAutoCpuAffinity(const std::vector<int> &reserved = std::vector<int>())
+    {
+        reservedCpus_ = reserved;
+        autoAffinity_ = true;
+    }
+
     // ???谁来调用传入cb
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
@@ -27,6 +38,14 @@ public:
 
     std::vector<EventLoop*> getAllLoops();
 
+    // 绑定在cpu上的subLoop，没有时返回nullptr；多个loop绑定同一CPU时返回第一个，start()之后可跨线程调用
+    EventLoop* getLoopForCpu(int cpu) const
+    {
+        return cpu >= 0 && static_cast<size_t>(cpu) < loopByCpu_.size() ? loopByCpu_[cpu] : nullptr;
+    }
+    // 各subLoop绑定的CPU，与getAllLoops()的顺序一致，-1表示未绑定；没有subLoop时为空
+    const std::vector<int>& loopCpus() const { return loopCpus_; }
+
     bool started() const { return started_; }
     const std::string name() const { return name_; }
 
@@ -39,4 +58,10 @@ private:
     int next_; // 轮询用的下标
     std::vector<std::unique_ptr<EventLoopThread>> threads_; // pool
     std::vector<EventLoop*> loops_;
+
+    bool autoAffinity_;
+    std::vector<int> cpus_;
+    std::vector<int> reservedCpus_;
+    std::vector<int> loopCpus_;
+    std::vector<EventLoop*> loopByCpu_; // 下标为CPU编号
 };
\ No newline at end of file
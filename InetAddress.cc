@@ -1,19 +1,111 @@
 #include "InetAddress.h"
+#include "Logger.h"
 
 #include <strings.h>
 #include <string.h>
+#include <stddef.h>
 
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
-    bzero(&addr_, sizeof addr_);
+    bzero(&addr6_, sizeof addr6_);
     addr_.sin_family = AF_INET;
     addr_.sin_port = htons(port);
     // 点分十进制地址转换为网络字节序（大端）地址
     addr_.sin_addr.s_addr = inet_addr(ip.c_str());
 
 }
+InetAddress::InetAddress(const sockaddr *addr, socklen_t len)
+{
+    bzero(&addr6_, sizeof addr6_);
+    if(len >= sizeof(sa_family_t) && addr->sa_family == AF_UNIX)
+    {
+        addr_.sin_family = AF_UNIX;
+        if(len > offsetof(sockaddr_un, sun_path))
+        {
+            std::shared_ptr<UnixAddr> unixAddr = std::make_shared<UnixAddr>();
+            bzero(&unixAddr->addr, sizeof unixAddr->addr);
+            unixAddr->len = len < sizeof(sockaddr_un) ? len : sizeof(sockaddr_un);
+            memcpy(&unixAddr->addr, addr, unixAddr->len);
+            unix_ = unixAddr;
+        }
+        return;
+    }
+    // len为0时地址族为AF_UNSPEC，即无效地址
+    memcpy(&addr6_, addr, len < sizeof addr6_ ? len : sizeof addr6_);
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string &path)
+{
+    sockaddr_un addr;
+    bzero(&addr, sizeof addr);
+    if(path.size() >= sizeof addr.sun_path)
+    {
+        // 截断后会绑定或连接到另一个路径，返回无效地址：Acceptor按致命错误处理，Connector按不可重试的connect错误通知上层
+        LOG_ERROR("%s:%s:%d unix socket path too long: %s \n", __FILE__, __FUNCTION__, __LINE__, path.c_str());
+        return InetAddress(reinterpret_cast<const sockaddr*>(&addr), 0);
+    }
+    addr.sun_family = AF_UNIX;
+    // 抽象地址首字节为'\0'，长度精确到名字末尾，不含结尾的'\0'
+    size_t len = path.size();
+    memcpy(addr.sun_path, path.data(), len);
+    bool abstract = len > 0 && path[0] == '@';
+    if(abstract)
+    {
+        addr.sun_path[0] = '\0';
+    }
+    socklen_t addrlen = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len + (abstract ? 0 : 1));
+    return InetAddress(reinterpret_cast<const sockaddr*>(&addr), addrlen);
+}
+
+bool InetAddress::isAbstract() const
+{
+    return unix_ && unix_->len > offsetof(sockaddr_un, sun_path) && unix_->addr.sun_path[0] == '\0';
+}
+
+std::string InetAddress::unixPath() const
+{
+    if(!unix_ || unix_->len <= offsetof(sockaddr_un, sun_path))
+    {
+        return std::string(); // 未绑定地址的客户端
+    }
+    size_t len = unix_->len - offsetof(sockaddr_un, sun_path);
+    if(isAbstract())
+    {
+        return "@" + std::string(unix_->addr.sun_path + 1, len - 1);
+    }
+    return std::string(unix_->addr.sun_path, strnlen(unix_->addr.sun_path, len));
+}
+
+const sockaddr* InetAddress::sockAddr() const
+{
+    if(unix_)
+    {
+        return reinterpret_cast<const sockaddr*>(&unix_->addr);
+    }
+    return reinterpret_cast<const sockaddr*>(&addr6_);
+}
+
+socklen_t InetAddress::sockAddrLen() const
+{
+    switch(family())
+    {
+    case AF_INET:
+        return sizeof(sockaddr_in);
+    case AF_INET6:
+        return sizeof(sockaddr_in6);
+    case AF_UNIX:
+        return unix_ ? unix_->len : static_cast<socklen_t>(sizeof(sa_family_t));
+    default:
+        return 0;
+    }
+}
+
 std::string InetAddress::toIp() const
 {
+    if(isUnix())
+    {
+        return unixPath();
+    }
     // addr_
     char buf[64] = {0};
     ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
@@ -21,6 +113,10 @@ std::string InetAddress::toIp() const
 }
 std::string InetAddress::toIpPort() const
 {
+    if(isUnix())
+    {
+        return "unix:" + unixPath();
+    }
     // ip:port
     char buf[64] = {0};
     ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
@@ -32,6 +128,10 @@ std::string InetAddress::toIpPort() const
 }
 uint16_t InetAddress::toPort() const
 {
+    if(isUnix())
+    {
+        return 0;
+    }
     return ntohs(addr_.sin_port);
 }
 
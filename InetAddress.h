@@ -2,9 +2,13 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <memory>
 #include <string>
 
 // 封装socket地址类型
+// 除IPv4地址外，也可以是AF_UNIX的路径地址或抽象命名空间地址（用于同机进程间通信）
 class InetAddress
 {
 public:
@@ -12,13 +16,49 @@ public:
     explicit InetAddress(const sockaddr_in &addr)
         : addr_(addr)
         {}
+    // 由getsockname/accept等返回的任意地址构造
+    InetAddress(const sockaddr *addr, socklen_t len);
 
+    // Unix域socket地址，path以'@'开头时表示抽象命名空间（不在文件系统中创建文件）
+    // path超过sun_path长度时返回无效地址（valid()为false）
+    static InetAddress fromUnixPath(const std::string &path);
+
+    // 地址族为AF_UNSPEC时无效
+    bool valid() const { return family() != AF_UNSPEC; }
+
+    sa_family_t family() const { return addr_.sin_family; }
+    bool isUnix() const { return family() == AF_UNIX; }
+    // 抽象命名空间的Unix域地址
+    bool isAbstract() const;
+    // Unix域地址的路径，抽象地址以'@'开头；IPv4地址返回空串
+    std::string unixPath() const;
+
+    // IPv4时为ip / ip:port / port；Unix域时为 路径 / unix:路径 / 0
     std::string toIp() const;
     std::string toIpPort() const;
     uint16_t toPort() const;
 
+    // 只对IPv4地址有意义
     const sockaddr_in* getSockAddr() const { return &addr_; }
-    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; unix_.reset(); }
+
+    // 通用的地址和长度，bind/connect等系统调用使用
+    const sockaddr* sockAddr() const;
+    socklen_t sockAddrLen() const;
+
 private:
-    sockaddr_in addr_;
-};
\ No newline at end of file
+    // sockaddr_un有110字节，每个连接都带着本端和对端两个地址，不能都按它的大小存放
+    // IPv4/IPv6地址就地存放；Unix域路径单独分配，副本之间共享，只有AF_UNIX且带路径时才分配
+    struct UnixAddr
+    {
+        sockaddr_un addr;
+        socklen_t len;
+    };
+
+    union
+    {
+        sockaddr_in addr_;
+        sockaddr_in6 addr6_; // 只用来留出空间
+    };
+    std::shared_ptr<const UnixAddr> unix_; // 没有路径的Unix域地址（如未绑定的客户端）为空，此时只有addr_的地址族有效
+};
@@ -0,0 +1,186 @@
+#include "ListenFdHandover.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const int ListenFdHandover::kMaxFds;
+
+static bool fillUnixAddr(const std::string &path, sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if(path.size() >= sizeof addr->sun_path)
+    {
+        LOG_ERROR("%s:%s:%d unix socket path too long: %s \n", __FILE__, __FUNCTION__, __LINE__, path.c_str());
+        return false;
+    }
+    memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static int createUnixListener(const std::string &path)
+{
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d unix socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+
+    sockaddr_un addr;
+    if(!fillUnixAddr(path, &addr))
+    {
+        ::close(sockfd);
+        return -1;
+    }
+    // 旧进程交接完成后会删除路径，这里删除的是异常退出遗留下来的
+    ::unlink(path.c_str());
+    if(::bind(sockfd, (sockaddr*)&addr, sizeof addr) < 0 || ::listen(sockfd, 4) < 0)
+    {
+        LOG_ERROR("%s:%s:%d bind/listen %s err:%d \n", __FILE__, __FUNCTION__, __LINE__, path.c_str(), errno);
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+ListenFdHandover::ListenFdHandover(EventLoop *loop, const std::string &path, const std::vector<int> &fds)
+    : loop_(loop)
+    , path_(path)
+    , fds_(fds)
+    , socket_(createUnixListener(path))
+    , channel_(loop, socket_.fd())
+    , active_(socket_.fd() >= 0)
+{
+    // 没有在监听的socket会一直报EPOLLHUP，创建失败时不注册
+    if(active_)
+    {
+        channel_.setReadCallback(std::bind(&ListenFdHandover::handleRead, this));
+        channel_.enableReading();
+    }
+}
+
+ListenFdHandover::~ListenFdHandover()
+{
+    close();
+}
+
+void ListenFdHandover::close()
+{
+    if(active_)
+    {
+        active_ = false;
+        channel_.disableAll();
+        channel_.remove();
+        ::unlink(path_.c_str());
+    }
+}
+
+// 新进程连上来了，把fds交给它
+void ListenFdHandover::handleRead()
+{
+    int connfd = ::accept4(socket_.fd(), nullptr, nullptr, SOCK_CLOEXEC);
+    if(connfd < 0)
+    {
+        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        return;
+    }
+
+    // 只交接一次，发送之前先删除路径：新进程收到fd后会在同一路径上等待它自己的继任者
+    close();
+
+    char data = 'F';
+    struct iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    memset(control, 0, sizeof control);
+    size_t numFds = fds_.size() < static_cast<size_t>(kMaxFds) ? fds_.size() : kMaxFds;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+    memcpy(CMSG_DATA(cmsg), fds_.data(), sizeof(int) * numFds);
+
+    ssize_t n = ::sendmsg(connfd, &msg, MSG_NOSIGNAL);
+    ::close(connfd);
+    if(n != 1)
+    {
+        LOG_ERROR("%s:%s:%d sendmsg err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        return;
+    }
+
+    LOG_INFO("ListenFdHandover handed %lu listen fds over %s\n", numFds, path_.c_str());
+    if(handoverCallback_)
+    {
+        handoverCallback_();
+    }
+}
+
+std::vector<int> ListenFdHandover::receive(const std::string &path)
+{
+    std::vector<int> fds;
+    sockaddr_un addr;
+    if(!fillUnixAddr(path, &addr))
+    {
+        return fds;
+    }
+
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sockfd < 0)
+    {
+        return fds;
+    }
+    if(::connect(sockfd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        // 没有旧进程在等待交接，正常启动
+        ::close(sockfd);
+        return fds;
+    }
+
+    char data;
+    struct iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    memset(control, 0, sizeof control);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    ::close(sockfd);
+    if(n != 1)
+    {
+        LOG_ERROR("%s:%s:%d recvmsg from %s err:%d \n", __FILE__, __FUNCTION__, __LINE__, path.c_str(), errno);
+        return fds;
+    }
+
+    for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t numFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int *received = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            fds.assign(received, received + numFds);
+        }
+    }
+    return fds;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Socket.h"
+#include "Channel.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+// 平滑重启时交接监听socket：
+// 旧进程在一个Unix域socket路径上等待，新进程连上来后，
+// 旧进程用SCM_RIGHTS把监听fd发给新进程，再通知上层停止accept
+// 两个进程共享同一个内核监听队列，交接过程中不会丢掉已完成握手的连接
+class ListenFdHandover : noncopyable
+{
+public:
+    using HandoverCallback = std::function<void()>;
+
+    // 旧进程：在loop上监听path，新进程连上来时把fds发过去
+    ListenFdHandover(EventLoop *loop, const std::string &path, const std::vector<int> &fds);
+    ~ListenFdHandover();
+
+    // 是否在path上等待新进程；路径过长或bind/listen失败时构造后即为false，交接完成后也变为false
+    bool listening() const { return active_; }
+
+    // fds成功发出后在loop线程中调用
+    void setHandoverCallback(const HandoverCallback &cb) { handoverCallback_ = cb; }
+
+    // 新进程：连接path，取回旧进程的监听fd；没有旧进程时返回空
+    // 阻塞调用，在启动loop之前使用
+    static std::vector<int> receive(const std::string &path);
+
+    static const int kMaxFds = 16;
+
+private:
+    void handleRead();
+    // 停止等待交接并删除路径
+    void close();
+
+    EventLoop *loop_;
+    const std::string path_;
+    const std::vector<int> fds_;
+    Socket socket_;
+    Channel channel_;
+    HandoverCallback handoverCallback_;
+    bool active_;
+};
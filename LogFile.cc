@@ -0,0 +1,128 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// stdio缓冲区大小，后台线程每次写入的都是整块日志，缓冲区大一些减少write次数
+static const size_t kFileBufferSize = 64 * 1024;
+
+LogFile::LogFile(const std::string &basename,
+                off_t rollSize,
+                int rollInterval,
+                int flushInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , rollInterval_(rollInterval > 0 ? rollInterval : 24 * 3600)
+    , flushInterval_(flushInterval)
+    , fp_(nullptr)
+    , buffer_(new char[kFileBufferSize])
+    , writtenBytes_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , lastFlush_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if(fp_)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *logline, size_t len)
+{
+    if(fp_ == nullptr)
+    {
+        return;
+    }
+    size_t written = 0;
+    while(written < len)
+    {
+        size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+        if(n == 0)
+        {
+            int err = ::ferror(fp_);
+            if(err)
+            {
+                // 日志本身写不出去时不能再走Logger，只能直接报到stderr
+                fprintf(stderr, "LogFile::append() failed %s\n", strerror(err));
+            }
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+
+    time_t now = ::time(nullptr);
+    if(writtenBytes_ > rollSize_ || now / rollInterval_ * rollInterval_ != startOfPeriod_)
+    {
+        rollFile();
+    }
+    else if(now - lastFlush_ >= flushInterval_)
+    {
+        lastFlush_ = now;
+        ::fflush(fp_);
+    }
+}
+
+void LogFile::flush()
+{
+    if(fp_)
+    {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile()
+{
+    time_t now = ::time(nullptr);
+    if(now <= lastRoll_)
+    {
+        return false;
+    }
+    std::string filename = getLogFileName(basename_, now);
+    FILE *fp = ::fopen(filename.c_str(), "ae"); // e: O_CLOEXEC
+    if(fp == nullptr)
+    {
+        fprintf(stderr, "LogFile::rollFile() open %s failed %s\n", filename.c_str(), strerror(errno));
+        return false;
+    }
+    if(fp_)
+    {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_.get(), kFileBufferSize);
+    lastRoll_ = now;
+    lastFlush_ = now;
+    startOfPeriod_ = now / rollInterval_ * rollInterval_;
+    writtenBytes_ = 0;
+    return true;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t now)
+{
+    std::string filename(basename);
+
+    char timebuf[32] = {0};
+    tm tm_time;
+    ::localtime_r(&now, &tm_time);
+    ::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm_time);
+    filename += timebuf;
+
+    char hostname[256] = {0};
+    if(::gethostname(hostname, sizeof hostname - 1) != 0)
+    {
+        strcpy(hostname, "unknownhost");
+    }
+    filename += hostname;
+
+    char pidbuf[32] = {0};
+    snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+// 滚动日志文件，只在AsyncLogging的后台线程中使用，不加锁
+// 文件名：basename.年月日-时分秒.主机名.pid.log
+// 写满rollSize字节或跨过rollInterval秒的整点周期（默认每天）时换一个新文件
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename,
+            off_t rollSize,
+            int rollInterval = 24 * 3600,
+            int flushInterval = 3);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    // 换一个新文件，同一秒内不会重复滚动
+    bool rollFile();
+
+    off_t writtenBytes() const { return writtenBytes_; }
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int rollInterval_;
+    const int flushInterval_;
+
+    FILE *fp_;
+    std::unique_ptr<char[]> buffer_; // stdio的用户态缓冲区
+    off_t writtenBytes_;
+    time_t startOfPeriod_; // 当前文件所在周期的起点
+    time_t lastRoll_;
+    time_t lastFlush_;
+};
@@ -2,6 +2,33 @@
 #include "Timestamp.h"
 
 #include <iostream>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// 大多数日志行放得下，超出时再按实际长度在堆上格式化一次
+static const size_t kInlineLineSize = 512;
+
+static const char* const kLevelNames[] =
+{
+    "[DEBUG]",
+    "[INFO]",
+    "[ERROR]",
+    "[FATAL]",
+};
+
+static void defaultOutput(const char *msg, size_t len)
+{
+    std::cout.write(msg, len);
+    std::cout.flush();
+}
+
+static void defaultFlush()
+{
+    std::cout.flush();
+}
+
+std::atomic_int Logger::logLevel_(INFO);
 
 // 懒汉单例
 Logger& Logger::instance()
@@ -9,31 +36,65 @@ Logger& Logger::instance()
     static Logger logger;
     return logger;
 }
-// 设置日志级别
-void Logger::setLogLevel(int level)
+
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
+
+void Logger::setOutput(OutputFunc out)
 {
-    logLevel_ = level;
+    output_ = out ? std::move(out) : OutputFunc(defaultOutput);
 }
+
+void Logger::setFlush(FlushFunc flush)
+{
+    flush_ = flush ? std::move(flush) : FlushFunc(defaultFlush);
+}
+
 // 写日志， [级别信息] time : msg
-void Logger::log(std::string msg)
+// 整行在一块缓冲区中拼好再交给output_，一行只输出一次
+void Logger::log(LogLevel level, const char *fmt, ...)
 {
-    switch(logLevel_)
+    // 前缀：[级别]年/月/日 时:分:秒.微秒 : ，时间部分按线程缓存，同一秒内只改写微秒
+    char line[kInlineLineSize];
+    size_t prefixLen = strlen(kLevelNames[level]);
+    memcpy(line, kLevelNames[level], prefixLen);
+    prefixLen += Timestamp::now().formatTo(line + prefixLen, kInlineLineSize - prefixLen);
+    memcpy(line + prefixLen, " : ", 3);
+    prefixLen += 3;
+
+    va_list args;
+    va_start(args, fmt);
+    va_list retry;
+    va_copy(retry, args);
+    int n = vsnprintf(line + prefixLen, kInlineLineSize - prefixLen, fmt, args);
+    va_end(args);
+    if(n < 0)
     {
-    case INFO:
-        std::cout << "[INFO]";
-        break;
-    case ERROR:
-        std::cout << "[ERROR]";
-        break;  
-    case FATAL:
-        std::cout << "[FATAL]";
-        break;
-    case DEBUG:
-        std::cout << "[DEBUG]";
-        break;
-    default:
-        break;
+        n = 0;
     }
 
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    size_t msgLen = static_cast<size_t>(n);
+    if(prefixLen + msgLen + 1 < kInlineLineSize)
+    {
+        line[prefixLen + msgLen] = '\n';
+        output_(line, prefixLen + msgLen + 1);
+    }
+    else
+    {
+        // 放不下，按实际长度重新格式化，不截断
+        std::string longLine(line, prefixLen);
+        longLine.resize(prefixLen + msgLen + 1);
+        vsnprintf(&longLine[prefixLen], msgLen + 1, fmt, retry);
+        longLine[prefixLen + msgLen] = '\n';
+        output_(longLine.data(), longLine.size());
+    }
+    va_end(retry);
+
+    if(level == FATAL)
+    {
+        flush_();
+    }
+}
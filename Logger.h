@@ -1,75 +1,107 @@
 #pragma once
+#include <atomic>
+#include <functional>
 #include <string>
+#include <stdlib.h>
 
 #include "noncopyable.h"
 
-// ???此处可优化，将主体内容写入log函数
 // 对外使用方法 LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...) \
+// 1. 先和运行时阈值比较（一次relaxed原子读），低于阈值时不格式化、不求值参数
+// 2. 低于编译期下限MYMUDUO_LOG_FLOOR的调用点整个被编译器删掉，但仍做格式串的类型检查
+// 3. 级别随每条日志传给Logger::log，不再修改共享状态；格式化结果不截断
+
+// 定义日志级别，数值越大越严重
+enum LogLevel
+{
+    DEBUG,  // 调试信息，量最大
+    INFO,   // 普通信息
+    ERROR,  // 错误信息
+    FATAL,  // core的信息
+};
+
+// 编译期日志下限，低于它的日志调用不会进入二进制
+// 定义了 MUDEBUG 时默认保留DEBUG，否则从INFO开始；也可以 -DMYMUDUO_LOG_FLOOR=2 只保留ERROR和FATAL
+#ifndef MYMUDUO_LOG_FLOOR
+#ifdef MUDEBUG
+#define MYMUDUO_LOG_FLOOR 0
+#else
+#define MYMUDUO_LOG_FLOOR 1
+#endif
+#endif
+
+#define MYMUDUO_LOG_IMPL(level, logmsgFormat, ...) \
     do \
     {   \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    }while(0) 
+        if(Logger::logLevel() <= level) \
+        {   \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+        }   \
+    }while(0)
 
-#define LOG_ERROR(logmsgFormat, ...) \
+// 被编译期下限去掉的级别：if(false)保证参数不求值，调用被优化掉，格式串仍做类型检查
+#define MYMUDUO_LOG_DISABLED(level, logmsgFormat, ...) \
     do \
     {   \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    }while(0) 
+        if(false) \
+        {   \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+        }   \
+    }while(0)
+
+#if MYMUDUO_LOG_FLOOR <= 0
+#define LOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG_IMPL(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_FLOOR <= 1
+#define LOG_INFO(logmsgFormat, ...) MYMUDUO_LOG_IMPL(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(INFO, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_FLOOR <= 2
+#define LOG_ERROR(logmsgFormat, ...) MYMUDUO_LOG_IMPL(ERROR, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(ERROR, logmsgFormat, ##__VA_ARGS__)
+#endif
 
+// FATAL不受阈值和编译期下限影响，总会输出并退出进程
 #define LOG_FATAL(logmsgFormat, ...) \
     do \
     {   \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        Logger::instance().log(FATAL, logmsgFormat, ##__VA_ARGS__); \
         exit(-1); \
     }while(0) 
 
-// 只有定义了 MUDEBUG 才以DEBUG级别输出日志
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...) \
-    do \
-    {   \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    }while(0) 
-#else 
-    #define LOG_DEBUG(logmsgFormat, ...) 
-#endif
-
-// 定义日志级别,枚举是整型，默认第一项从0开始
-enum LogLevel
-{
-    INFO,   // 普通信息
-    ERROR,  // 错误信息
-    FATAL,  // core的信息
-    DEBUG,  // 调试信息，量最大
-};
-
 class Logger : noncopyable
 {
 public:
+    // msg是格式化好的一整行（以换行结尾），默认写到std::cout
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
     // 获取日志唯一实例对象
     static Logger& instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行时阈值，低于它的日志不输出，默认INFO，可在任意线程修改
+    static LogLevel logLevel() { return static_cast<LogLevel>(logLevel_.load(std::memory_order_relaxed)); }
+    static void setLogLevel(LogLevel level) { logLevel_.store(level, std::memory_order_relaxed); }
+
+    // 格式化并写一条日志， [级别信息] time : msg
+    // format属性让编译器按printf规则检查参数类型
+    void log(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    // 替换日志输出，例如交给AsyncLogging；须在其他线程开始写日志之前设置
+    void setOutput(OutputFunc out);
+    // LOG_FATAL退出进程前调用，保证已写的日志落盘
+    void setFlush(FlushFunc flush);
 
 private:
-    int logLevel_; // 结尾_ 防止和系统定义的变量混淆
-};
\ No newline at end of file
+    Logger();
+
+    static std::atomic_int logLevel_; // 结尾_ 防止和系统定义的变量混淆
+    OutputFunc output_;
+    FlushFunc flush_;
+};
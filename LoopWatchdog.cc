@@ -0,0 +1,217 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <execinfo.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+const int LoopWatchdog::kMaxFrames;
+
+namespace
+{
+    // 信号处理函数只能访问全局变量，同一时刻只抓取一个线程
+    // 等待超时后，迟到的信号处理函数仍可能执行，每次抓取都带一个序号：
+    // 请求（序号<<32 | tid）在tgkill之前发布，处理函数把序号和自己的tid记在结果旁边，二者都对上才采用
+    std::mutex g_captureMutex;
+    std::atomic<uint64_t> g_request(0);
+    std::atomic_bool g_writing(false); // 同一时刻只有一个处理函数写g_frames
+    void *g_frames[LoopWatchdog::kMaxFrames];
+    int g_numFrames = 0;
+    std::atomic<uint64_t> g_result(0); // 最近一次写完的结果对应的请求
+
+    // 在被卡住的loop线程中执行，只调用backtrace()，它在第一次调用之后是异步信号安全的
+    void captureHandler(int)
+    {
+        int savedErrno = errno;
+        uint64_t request = g_request.load(std::memory_order_acquire);
+        uint32_t tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+        bool expected = false;
+        // 不是发给本线程的请求、已经有结果、或者另一个处理函数正在写，都不动共享的缓冲区
+        if(static_cast<uint32_t>(request) == tid
+            && g_result.load(std::memory_order_acquire) != request
+            && g_writing.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            // 抢到写权限之前请求可能已经换了，或者已经由别的处理函数写完
+            if(g_request.load(std::memory_order_acquire) == request
+                && g_result.load(std::memory_order_acquire) != request)
+            {
+                g_numFrames = ::backtrace(g_frames, LoopWatchdog::kMaxFrames);
+                g_result.store(request, std::memory_order_release);
+            }
+            g_writing.store(false, std::memory_order_release);
+        }
+        errno = savedErrno;
+    }
+}
+
+LoopWatchdog::LoopWatchdog(double stallThreshold, int signo)
+    : stallThresholdMicros_(static_cast<int64_t>(stallThreshold * Timer::kMicroSecondsPerSecond))
+    , signo_(signo)
+    , running_(false)
+    , stalls_(0)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    Watched watched;
+    watched.loop = loop;
+    watched.reported = false;
+    watched.reportedPoll = 0;
+    watched_.push_back(watched);
+}
+
+void LoopWatchdog::unwatch(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    watched_.erase(std::remove_if(watched_.begin(), watched_.end(),
+        [loop](const Watched &w) { return w.loop == loop; }), watched_.end());
+}
+
+void LoopWatchdog::start()
+{
+    // backtrace()第一次调用会加载libgcc，可能分配内存，先在这里调用一次
+    void *frame = nullptr;
+    ::backtrace(&frame, 1);
+
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof sa);
+    sa.sa_handler = captureHandler;
+    sa.sa_flags = SA_RESTART; // 被打断的系统调用自动重启，不影响loop线程
+    ::sigemptyset(&sa.sa_mask);
+    if(::sigaction(signo_, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("LoopWatchdog::start sigaction(%d) errno:%d \n", signo_, errno);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    thread_.reset(new Thread(std::bind(&LoopWatchdog::threadFunc, this), "LoopWatchdog"));
+    thread_->start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_all();
+    thread_->join();
+    thread_.reset();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    // 检查间隔为阈值的一半，卡顿最晚在1.5倍阈值时被发现
+    std::chrono::microseconds interval(std::max<int64_t>(stallThresholdMicros_ / 2, 1000));
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_)
+    {
+        cond_.wait_for(lock, interval);
+        if(running_)
+        {
+            check();
+        }
+    }
+}
+
+// 持有mutex_调用，保证检查期间被监视的loop不会被unwatch
+void LoopWatchdog::check()
+{
+    for(Watched &w : watched_)
+    {
+        int64_t lag = w.loop->lagMicros();
+        uint64_t polls = w.loop->metrics().polls.value();
+        if(lag <= stallThresholdMicros_)
+        {
+            w.reported = false;
+            continue;
+        }
+        if(w.reported && w.reportedPoll == polls)
+        {
+            continue; // 还是上次报告过的那次卡顿
+        }
+        w.reported = true;
+        w.reportedPoll = polls;
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+
+        std::string stack = captureStack(w.loop->threadId());
+        if(stallCallback_)
+        {
+            stallCallback_(w.loop, lag, stack);
+        }
+        else
+        {
+            LOG_ERROR("LoopWatchdog: EventLoop %p (tid %d) has not returned to epoll_wait for %lld us, stack:\n%s",
+                w.loop, w.loop->threadId(), static_cast<long long>(lag), stack.c_str());
+        }
+    }
+}
+
+std::string LoopWatchdog::captureStack(pid_t tid)
+{
+    std::unique_lock<std::mutex> lock(g_captureMutex);
+    static uint32_t seq = 0;
+    uint64_t request = (static_cast<uint64_t>(++seq) << 32) | static_cast<uint32_t>(tid);
+    g_request.store(request, std::memory_order_release);
+    if(::syscall(SYS_tgkill, ::getpid(), tid, signo_) < 0)
+    {
+        LOG_ERROR("LoopWatchdog::captureStack tgkill(%d) errno:%d \n", tid, errno);
+        return std::string();
+    }
+
+    // 最多等100ms；线程阻塞了该信号或正在不可中断的睡眠中时取不到
+    // 结果与本次请求对上之后，后到的处理函数看到g_result == g_request，不会再改写g_frames
+    bool done = false;
+    for(int i = 0; i < 100 && !(done = g_result.load(std::memory_order_acquire) == request); ++i)
+    {
+        ::usleep(1000);
+    }
+    int n = g_numFrames;
+    if(!done || n <= 0)
+    {
+        return std::string();
+    }
+
+    std::string stack;
+    char **symbols = ::backtrace_symbols(g_frames, n);
+    // 前两帧是captureHandler和信号跳板，跳过
+    for(int i = 2; i < n; ++i)
+    {
+        char buf[32] = {0};
+        snprintf(buf, sizeof buf, "  #%d ", i - 2);
+        stack.append(buf);
+        if(symbols != nullptr)
+        {
+            stack.append(symbols[i]);
+        }
+        else
+        {
+            snprintf(buf, sizeof buf, "%p", g_frames[i]);
+            stack.append(buf);
+        }
+        stack.append("\n");
+    }
+    ::free(symbols);
+    return stack;
+}
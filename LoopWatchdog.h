@@ -0,0 +1,72 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <stdint.h>
+
+class EventLoop;
+
+// loop卡死检测：后台线程定期检查被监视的loop，某一轮事件处理超过stallThreshold秒还没回到epoll_wait时，
+// 向该loop线程发信号，在信号处理函数中用backtrace()抓取它当时的调用栈，再由后台线程解析符号写进日志
+// 同一次卡顿只报告一次；需要看到可执行文件中的函数名时链接加 -rdynamic
+//   LoopWatchdog watchdog(0.2);
+//   server.setThreadInitCallback([&](EventLoop *loop) { watchdog.watch(loop); });
+//   watchdog.start();
+class LoopWatchdog : noncopyable
+{
+public:
+    // 发现卡顿时调用（在看门狗线程中），stack为解析好的调用栈，每行一帧，抓取失败时为空
+    using StallCallback = std::function<void(EventLoop*, int64_t lagMicros, const std::string &stack)>;
+
+    static const int kMaxFrames = 64;
+
+    // signo为抓取调用栈使用的信号，进程中不能有其他用途
+    explicit LoopWatchdog(double stallThreshold, int signo = SIGUSR2);
+    ~LoopWatchdog();
+
+    // 监视/取消监视一个loop，可在任意线程调用；loop销毁前须先unwatch或stop
+    void watch(EventLoop *loop);
+    void unwatch(EventLoop *loop);
+
+    // 默认只写ERROR日志
+    void setStallCallback(const StallCallback &cb) { stallCallback_ = cb; }
+
+    void start();
+    void stop();
+
+    // 发现的卡顿次数
+    uint64_t numStalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+    struct Watched
+    {
+        EventLoop *loop;
+        bool reported;        // 本次卡顿已经报告过
+        uint64_t reportedPoll; // 报告时loop的epoll_wait次数，变化说明已经恢复过
+    };
+
+    void threadFunc();
+    void check();
+    // 向tid发信号并等待信号处理函数抓完调用栈，返回解析后的文本
+    std::string captureStack(pid_t tid);
+
+    const int64_t stallThresholdMicros_;
+    const int signo_;
+    StallCallback stallCallback_;
+
+    std::mutex mutex_; // 保护watched_和running_
+    std::condition_variable cond_;
+    std::vector<Watched> watched_;
+    bool running_;
+    std::unique_ptr<Thread> thread_;
+    std::atomic<uint64_t> stalls_;
+};
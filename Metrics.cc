@@ -0,0 +1,144 @@
+#include "Metrics.h"
+
+#include <stdio.h>
+
+const int MetricsHistogram::kNumBuckets;
+
+void MetricsWriter::HistogramSnapshot::add(const MetricsHistogram &h)
+{
+    for(int i = 0; i < MetricsHistogram::kNumBuckets; ++i)
+    {
+        buckets[i] += h.bucket(i);
+    }
+    count += h.count();
+    sum += h.sum();
+}
+
+MetricsWriter::Family& MetricsWriter::family(const char *name, const char *help, const char *type)
+{
+    Family &f = families_[name];
+    if(f.help.empty())
+    {
+        f.help = help;
+        f.type = type;
+    }
+    return f;
+}
+
+void MetricsWriter::counter(const char *name, const char *help, const std::string &labels, uint64_t value)
+{
+    char buf[32] = {0};
+    snprintf(buf, sizeof buf, " %llu\n", static_cast<unsigned long long>(value));
+    std::string &samples = family(name, help, "counter").samples;
+    samples.append(name);
+    if(!labels.empty())
+    {
+        samples.append("{").append(labels).append("}");
+    }
+    samples.append(buf);
+}
+
+void MetricsWriter::gauge(const char *name, const char *help, const std::string &labels, int64_t value)
+{
+    char buf[32] = {0};
+    snprintf(buf, sizeof buf, " %lld\n", static_cast<long long>(value));
+    std::string &samples = family(name, help, "gauge").samples;
+    samples.append(name);
+    if(!labels.empty())
+    {
+        samples.append("{").append(labels).append("}");
+    }
+    samples.append(buf);
+}
+
+void MetricsWriter::histogram(const char *name, const char *help, const std::string &labels, const HistogramSnapshot &h)
+{
+    std::string &samples = family(name, help, "histogram").samples;
+    std::string prefix = labels.empty() ? std::string() : labels + ",";
+    char buf[96] = {0};
+    // Prometheus的桶是累计的：le="x"表示 <= x 的总数
+    uint64_t cumulative = 0;
+    for(int i = 0; i < MetricsHistogram::kNumBuckets; ++i)
+    {
+        cumulative += h.buckets[i];
+        snprintf(buf, sizeof buf, "_bucket{%sle=\"%llu\"} %llu\n", prefix.c_str(),
+            1ULL << i, static_cast<unsigned long long>(cumulative));
+        samples.append(name).append(buf);
+    }
+    snprintf(buf, sizeof buf, "_bucket{%sle=\"+Inf\"} %llu\n", prefix.c_str(), static_cast<unsigned long long>(h.count));
+    samples.append(name).append(buf);
+
+    std::string suffix = labels.empty() ? std::string() : "{" + labels + "}";
+    snprintf(buf, sizeof buf, "_sum%s %llu\n", suffix.c_str(), static_cast<unsigned long long>(h.sum));
+    samples.append(name).append(buf);
+    snprintf(buf, sizeof buf, "_count%s %llu\n", suffix.c_str(), static_cast<unsigned long long>(h.count));
+    samples.append(name).append(buf);
+}
+
+std::string MetricsWriter::str() const
+{
+    std::string out;
+    for(const auto &item : families_)
+    {
+        out.append("# HELP ").append(item.first).append(" ").append(item.second.help).append("\n");
+        out.append("# TYPE ").append(item.first).append(" ").append(item.second.type).append("\n");
+        out.append(item.second.samples);
+    }
+    return out;
+}
+
+std::string MetricsWriter::escapeLabel(const std::string &value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for(char c : value)
+    {
+        if(c == '\\' || c == '"')
+        {
+            out.push_back('\\');
+            out.push_back(c);
+        }
+        else if(c == '\n')
+        {
+            out.append("\\n");
+        }
+        else
+        {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+uint64_t MetricsRegistry::add(const Collector &collector)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t id = nextId_++;
+    collectors_[id] = collector;
+    return id;
+}
+
+void MetricsRegistry::remove(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    collectors_.erase(id);
+}
+
+std::string MetricsRegistry::scrape()
+{
+    MetricsWriter writer;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for(auto &item : collectors_)
+        {
+            item.second(writer);
+        }
+    }
+    return writer.str();
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "ConnectionLatency.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+// 运行时指标，按Prometheus文本格式导出
+// 1. 指标按线程分片：每个EventLoop、每个TcpServer的每个subLoop分片各一份，只有所属loop线程写
+//    写入是普通的load+store，不带lock前缀；抓取时其他线程用relaxed load读，不加锁
+// 2. 各模块把自己的分片以收集函数的形式登记到MetricsRegistry，抓取时逐个调用并汇总
+// 3. MetricsServer用一个内置的TcpServer响应 GET /metrics
+
+// 单写者计数器，只能在所属线程中修改
+class MetricsCounter : noncopyable
+{
+public:
+    MetricsCounter() : value_(0) {}
+
+    void add(uint64_t n) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void increment() { add(1); }
+    // 可在任意线程读取
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_;
+};
+
+// 单写者直方图，桶的上界依次为 1 2 4 ... 2^(kNumBuckets-1)，超过的只计入+Inf
+class MetricsHistogram : noncopyable
+{
+public:
+    static const int kNumBuckets = 20;
+
+    void observe(uint64_t v)
+    {
+        int i = v <= 1 ? 0 : 64 - __builtin_clzll(v - 1);
+        if(i < kNumBuckets)
+        {
+            buckets_[i].increment();
+        }
+        count_.increment();
+        sum_.add(v);
+    }
+
+    uint64_t bucket(int i) const { return buckets_[i].value(); }
+    uint64_t count() const { return count_.value(); }
+    uint64_t sum() const { return sum_.value(); }
+
+private:
+    MetricsCounter buckets_[kNumBuckets];
+    MetricsCounter count_;
+    MetricsCounter sum_;
+};
+
+// 每个EventLoop一份，只在loop线程中更新
+struct LoopMetrics
+{
+    MetricsCounter polls;            // epoll_wait调用次数
+    MetricsCounter events;           // epoll_wait返回的事件总数
+    MetricsHistogram eventsPerPoll;  // 每次epoll_wait返回的事件数
+    MetricsCounter blockedMicros;    // 阻塞在epoll_wait中的时间
+    MetricsCounter busyMicros;       // 处理事件和回调的时间
+    MetricsCounter functors;         // 执行的跨线程回调个数
+    MetricsHistogram functorsPerBatch; // 每轮doPendingFunctors执行的回调个数
+    MetricsCounter slowCallbacks;    // 超过慢回调阈值的回调个数
+};
+
+// TcpServer每个subLoop分片一份，经TcpConnectionCallbacks交给该分片的连接，只在该loop线程中更新
+struct ConnectionMetrics
+{
+    MetricsCounter accepted;
+    MetricsCounter closed;
+    MetricsCounter bytesRead;
+    MetricsCounter bytesWritten;
+    MetricsCounter bytesQueued;      // 没能直接写入内核、放进outputBuffer_的字节数
+    MetricsCounter highWaterMarkHits;
+    // 开启延迟跟踪时各阶段的耗时（微秒）
+    MetricsHistogram latency[ConnectionLatency::kNumPhases];
+    // 开启TCP_INFO采样时每个样本的分布，见TcpInfo
+    MetricsCounter tcpInfoSamples;
+    MetricsHistogram rttMicros;
+    MetricsHistogram cwndSegments;
+    MetricsHistogram unackedSegments;
+    MetricsHistogram totalRetrans;
+    MetricsHistogram inFlightBytes;
+    MetricsHistogram notSentBytes;
+    MetricsHistogram outputBufferBytes;
+};
+
+// 抓取时收集各分片的样本，同名指标的样本归到一起，按Prometheus文本格式输出
+class MetricsWriter : noncopyable
+{
+public:
+    // labels形如 loop="1234",server="echo"，可以为空，值须先经escapeLabel处理
+    void counter(const char *name, const char *help, const std::string &labels, uint64_t value);
+    void gauge(const char *name, const char *help, const std::string &labels, int64_t value);
+    // 多个分片的直方图汇总成一条时，先用HistogramSnapshot累加
+    struct HistogramSnapshot
+    {
+        HistogramSnapshot() : buckets(), count(0), sum(0) {}
+        void add(const MetricsHistogram &h);
+
+        uint64_t buckets[MetricsHistogram::kNumBuckets];
+        uint64_t count;
+        uint64_t sum;
+    };
+    void histogram(const char *name, const char *help, const std::string &labels, const HistogramSnapshot &h);
+
+    std::string str() const;
+
+    // 转义标签值中的 \ " 和换行
+    static std::string escapeLabel(const std::string &value);
+
+private:
+    struct Family
+    {
+        std::string help;
+        const char *type;
+        std::string samples;
+    };
+    Family& family(const char *name, const char *help, const char *type);
+
+    std::map<std::string, Family> families_; // 按名字排序输出，便于diff
+};
+
+class MetricsRegistry : noncopyable
+{
+public:
+    using Collector = std::function<void(MetricsWriter&)>;
+
+    static MetricsRegistry& instance();
+
+    // 登记一个收集函数，返回的id用于注销；注销返回后收集函数不会再被调用
+    uint64_t add(const Collector &collector);
+    void remove(uint64_t id);
+
+    // 调用所有收集函数，返回Prometheus文本格式，可在任意线程调用
+    std::string scrape();
+
+private:
+    MetricsRegistry() : nextId_(1) {}
+
+    std::mutex mutex_; // 抓取期间持有，注销须等抓取结束
+    std::map<uint64_t, Collector> collectors_;
+    uint64_t nextId_;
+};
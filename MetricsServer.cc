@@ -0,0 +1,64 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include "Buffer.h"
+
+#include <algorithm>
+
+const size_t MetricsServer::kMaxRequestSize;
+
+static std::string httpResponse(const char *status, const std::string &body)
+{
+    std::string response("HTTP/1.1 ");
+    response.append(status).append("\r\n");
+    response.append("Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n");
+    response.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+    response.append("Connection: close\r\n\r\n");
+    response.append(body);
+    return response;
+}
+
+MetricsServer::MetricsServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &nameArg)
+    : server_(loop, listenAddr, nameArg)
+{
+    server_.setMessageCallback(std::bind(&MetricsServer::onMessage, this,
+        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void MetricsServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    static const char kHeaderEnd[] = "\r\n\r\n";
+    const char *end = std::search(buf->peek(), buf->peek() + buf->readableBytes(),
+                                kHeaderEnd, kHeaderEnd + 4);
+    if(end == buf->peek() + buf->readableBytes())
+    {
+        // 请求还没收全
+        if(buf->readableBytes() > kMaxRequestSize)
+        {
+            buf->retriveAll();
+            conn->shutdown();
+        }
+        return;
+    }
+
+    std::string request(buf->peek(), end);
+    buf->retriveAll();
+    std::string path;
+    size_t sp1 = request.find(' ');
+    size_t sp2 = sp1 == std::string::npos ? sp1 : request.find(' ', sp1 + 1);
+    if(request.compare(0, 4, "GET ") == 0 && sp2 != std::string::npos)
+    {
+        path = request.substr(sp1 + 1, sp2 - sp1 - 1);
+    }
+
+    if(path == "/metrics" || path == "/")
+    {
+        conn->send(httpResponse("200 OK", MetricsRegistry::instance().scrape()));
+    }
+    else
+    {
+        conn->send(httpResponse("404 Not Found", "not found\n"));
+    }
+    conn->shutdown();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+
+#include <string>
+
+// 内置的指标端点：在loop上起一个TcpServer，对 GET /metrics 返回MetricsRegistry的Prometheus文本
+// 只实现抓取所需的最小HTTP：每个连接处理一个请求，响应后关闭
+// 抓取在loop线程中进行，通常放在baseLoop或单独的线程，不占用subLoop
+//   MetricsServer metrics(&loop, InetAddress(9100));
+//   metrics.start();
+class MetricsServer : noncopyable
+{
+public:
+    static const size_t kMaxRequestSize = 8192; // 请求头超过这个长度还没结束就关闭连接
+
+    MetricsServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &nameArg = "metrics");
+
+    void start() { server_.start(); }
+
+private:
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    TcpServer server_;
+};
@@ -0,0 +1,156 @@
+#include "PerfCounters.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+int PerfCounters::defaultSampleEvery_ = 0;
+
+const char* PerfCounters::eventName(int event)
+{
+    static const char *kNames[kNumEvents] = { "cycles", "instructions", "cache_misses", "context_switches" };
+    return event >= 0 && event < kNumEvents ? kNames[event] : "unknown";
+}
+
+const char* PerfCounters::phaseName(int phase)
+{
+    static const char *kNames[kNumPhases] = { "poll", "dispatch", "functors" };
+    return phase >= 0 && phase < kNumPhases ? kNames[phase] : "unknown";
+}
+
+PerfCounters::PerfCounters(int sampleEvery)
+    : sampleEvery_(sampleEvery > 0 ? sampleEvery : 1)
+    , iteration_(0)
+    , leaderFd_(-1)
+    , numOpened_(0)
+    , kernelCounted_(true)
+{
+    for(int i = 0; i < kNumEvents; ++i)
+    {
+        fds_[i] = -1;
+        index_[i] = -1;
+        last_[i] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for(int fd : fds_)
+    {
+        if(fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+int PerfCounters::openEvent(uint32_t type, uint64_t config, int groupFd, bool excludeKernel)
+{
+    struct perf_event_attr attr;
+    ::memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = excludeKernel ? 1 : 0;
+    attr.exclude_hv = 1;
+    // pid=0 cpu=-1: 只统计调用线程，跟随它在任意CPU上运行
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+}
+
+bool PerfCounters::open()
+{
+    struct Spec
+    {
+        Event event;
+        uint32_t type;
+        uint64_t config;
+    };
+    // 组长必须是硬件事件，硬件事件才能和它一起调度；打不开cycles时退化为只有软件事件的组
+    static const Spec kSpecs[kNumEvents] = {
+        { kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { kInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { kCacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { kContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    };
+
+    // 先试着连内核态一起统计，没有权限时只统计用户态
+    int leader = openEvent(kSpecs[0].type, kSpecs[0].config, -1, false);
+    if(leader < 0 && (errno == EACCES || errno == EPERM))
+    {
+        kernelCounted_ = false;
+        leader = openEvent(kSpecs[0].type, kSpecs[0].config, -1, true);
+    }
+    if(leader < 0)
+    {
+        LOG_INFO("PerfCounters: hardware counters unavailable errno:%d, counting context switches only \n", errno);
+        leader = openEvent(kSpecs[kContextSwitches].type, kSpecs[kContextSwitches].config, -1, !kernelCounted_);
+        if(leader < 0 && kernelCounted_ && (errno == EACCES || errno == EPERM))
+        {
+            kernelCounted_ = false;
+            leader = openEvent(kSpecs[kContextSwitches].type, kSpecs[kContextSwitches].config, -1, true);
+        }
+        if(leader < 0)
+        {
+            LOG_INFO("PerfCounters: perf_event_open unavailable errno:%d \n", errno);
+            return false;
+        }
+        fds_[kContextSwitches] = leader;
+        index_[kContextSwitches] = numOpened_++;
+        leaderFd_ = leader;
+        return true;
+    }
+    fds_[kCycles] = leader;
+    index_[kCycles] = numOpened_++;
+    leaderFd_ = leader;
+
+    for(int i = 1; i < kNumEvents; ++i)
+    {
+        int fd = openEvent(kSpecs[i].type, kSpecs[i].config, leaderFd_, !kernelCounted_);
+        if(fd < 0)
+        {
+            LOG_INFO("PerfCounters: %s unavailable errno:%d \n", eventName(kSpecs[i].event), errno);
+            continue;
+        }
+        fds_[kSpecs[i].event] = fd;
+        index_[kSpecs[i].event] = numOpened_++;
+    }
+    return true;
+}
+
+bool PerfCounters::read(uint64_t *values)
+{
+    // PERF_FORMAT_GROUP: u64 nr, u64 values[nr]，顺序和加入组的顺序相同
+    uint64_t buf[1 + kNumEvents];
+    ssize_t n = ::read(leaderFd_, buf, sizeof buf);
+    if(n < static_cast<ssize_t>(sizeof(uint64_t) * (1 + numOpened_)))
+    {
+        return false;
+    }
+    for(int i = 0; i < kNumEvents; ++i)
+    {
+        values[i] = index_[i] >= 0 ? buf[1 + index_[i]] : 0;
+    }
+    return true;
+}
+
+void PerfCounters::endPhase(int phase)
+{
+    uint64_t now[kNumEvents];
+    if(!read(now))
+    {
+        return;
+    }
+    for(int i = 0; i < kNumEvents; ++i)
+    {
+        totals_[phase][i].add(now[i] - last_[i]);
+        last_[i] = now[i];
+    }
+    if(phase == kNumPhases - 1)
+    {
+        sampled_.increment();
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Metrics.h"
+
+#include <stdint.h>
+
+// 一个loop线程的硬件性能计数器（perf_event_open），按loop的阶段累计
+// 1. 在loop线程中打开，只统计本线程；cycles/instructions/cache-misses/context-switches放在一个组里，
+//    一次read()读出全部；硬件计数器不可用（虚拟机、容器、perf_event_paranoid）时只保留context-switches，
+//    都不可用时open()返回false，loop照常运行
+// 2. 每sampleEvery轮循环采样一轮，在阶段边界各读一次，差值计入该阶段；每次读是一次系统调用，
+//    采样间隔决定了开销，默认64轮一次
+// 内核态不可统计时（perf_event_paranoid >= 2）只计用户态，poll阶段的数值主要反映epoll_wait前后的用户态代码
+class PerfCounters : noncopyable
+{
+public:
+    enum Event
+    {
+        kCycles,
+        kInstructions,
+        kCacheMisses,
+        kContextSwitches,
+        kNumEvents,
+    };
+
+    enum Phase
+    {
+        kPoll,      // epoll_wait
+        kDispatch,  // 处理活跃Channel
+        kFunctors,  // doPendingFunctors
+        kNumPhases,
+    };
+
+    static const char* eventName(int event);
+    static const char* phaseName(int phase);
+
+    // EventLoopThread启动loop时按这里的设置打开，0表示不打开（默认），须在创建线程池之前设置
+    static void setDefaultSampleEvery(int sampleEvery) { defaultSampleEvery_ = sampleEvery; }
+    static int defaultSampleEvery() { return defaultSampleEvery_; }
+
+    explicit PerfCounters(int sampleEvery);
+    ~PerfCounters();
+
+    // 为当前线程打开计数器，一个都打不开时返回false
+    bool open();
+    bool available(int event) const { return index_[event] >= 0; }
+    bool kernelCounted() const { return kernelCounted_; }
+
+    // 由EventLoop在每轮循环开始时调用，返回本轮是否采样
+    bool beginIteration()
+    {
+        if(++iteration_ % sampleEvery_ != 0)
+        {
+            return false;
+        }
+        return read(last_);
+    }
+    // 本轮采样时在阶段结束处调用
+    void endPhase(int phase);
+
+    uint64_t sampledIterations() const { return sampled_.value(); }
+    uint64_t value(int phase, int event) const { return totals_[phase][event].value(); }
+
+private:
+    bool read(uint64_t *values);
+    int openEvent(uint32_t type, uint64_t config, int groupFd, bool excludeKernel);
+
+    static int defaultSampleEvery_;
+
+    const int sampleEvery_;
+    uint64_t iteration_;
+    int leaderFd_;
+    int fds_[kNumEvents];
+    int index_[kNumEvents]; // 事件在组读结果中的位置，-1表示没打开
+    int numOpened_;
+    bool kernelCounted_;
+
+    uint64_t last_[kNumEvents];
+    MetricsCounter sampled_;
+    MetricsCounter totals_[kNumPhases][kNumEvents];
+};
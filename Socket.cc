@@ -2,11 +2,13 @@
 #include "Logger.h"
 #include "InetAddress.h"
 
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <strings.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
+#include <linux/net_tstamp.h>
 
 Socket::~Socket()
 {
@@ -15,16 +17,16 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr)
 {
-    if(0 != bind(sockfd_, (sockaddr*)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    if(0 != bind(sockfd_, localaddr.sockAddr(), localaddr.sockAddrLen()))
     {
         LOG_FATAL("bind sockfd:%d fail \n", sockfd_);
     }
 }
 
-void Socket::listen()
+void Socket::listen(int backlog)
 {
     // 第二个参数是accept队列大小
-    if(0 != ::listen(sockfd_, 1024))
+    if(0 != ::listen(sockfd_, backlog))
     {
         LOG_FATAL("listen sockfd:%d fail \n", sockfd_);
 
@@ -39,14 +41,15 @@ int Socket::accept(InetAddress *peeraddr)
     // Reactor模型 one loop per thread
     // poller + non-blocking IO
 
-    sockaddr_in addr;
+    // 足够放下IPv4和Unix域地址
+    sockaddr_storage addr;
     socklen_t len = sizeof addr;
     bzero(&addr, sizeof addr);
     // sockfd是listen用
     int connfd = ::accept4(sockfd_, (sockaddr*)&addr, &len, SOCK_CLOEXEC | SOCK_NONBLOCK);
     if(connfd >= 0)
     {
-        peeraddr->setSockAddr(addr); // 通过输出参数传出连接到的对端的地址
+        *peeraddr = InetAddress((sockaddr*)&addr, len); // 通过输出参数传出连接到的对端的地址
     }
 
     return connfd;
@@ -82,4 +85,92 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
+}
+
+void Socket::setTcpQuickAck(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof optval);
+}
+
+void Socket::setTcpNotSentLowat(int bytes)
+{
+    if(::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof bytes) < 0)
+    {
+        LOG_ERROR("setsockopt TCP_NOTSENT_LOWAT sockfd:%d errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setRecvBufferSize(int bytes)
+{
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof bytes) < 0)
+    {
+        LOG_ERROR("setsockopt SO_RCVBUF sockfd:%d errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setSendBufferSize(int bytes)
+{
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof bytes) < 0)
+    {
+        LOG_ERROR("setsockopt SO_SNDBUF sockfd:%d errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setBusyPoll(int micros)
+{
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &micros, sizeof micros) < 0)
+    {
+        LOG_ERROR("setsockopt SO_BUSY_POLL sockfd:%d errno:%d \n", sockfd_, errno);
+    }
+}
+
+bool Socket::setRxTimestamping(bool on)
+{
+    int flags = on ? (SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE) : 0;
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags) < 0)
+    {
+        LOG_ERROR("setsockopt SO_TIMESTAMPING sockfd:%d errno:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+void Socket::setDeferAccept(int seconds)
+{
+    if(::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof seconds) < 0)
+    {
+        LOG_ERROR("setsockopt TCP_DEFER_ACCEPT sockfd:%d errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setFastOpen(int queueLen)
+{
+    if(::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &queueLen, sizeof queueLen) < 0)
+    {
+        LOG_ERROR("setsockopt TCP_FASTOPEN sockfd:%d errno:%d \n", sockfd_, errno);
+    }
+}
+InetAddress Socket::getLocalAddr(int sockfd)
+{
+    sockaddr_storage addr;
+    bzero(&addr, sizeof addr);
+    socklen_t addrlen = sizeof addr;
+    if(::getsockname(sockfd, (sockaddr*)&addr, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getLocalAddr");
+    }
+    return InetAddress((sockaddr*)&addr, addrlen);
+}
+
+InetAddress Socket::getPeerAddr(int sockfd)
+{
+    sockaddr_storage addr;
+    bzero(&addr, sizeof addr);
+    socklen_t addrlen = sizeof addr;
+    if(::getpeername(sockfd, (sockaddr*)&addr, &addrlen) < 0)
+    {
+        LOG_ERROR("sockets::getPeerAddr");
+    }
+    return InetAddress((sockaddr*)&addr, addrlen);
 }
\ No newline at end of file
@@ -17,7 +17,7 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress &localaddr);
-    void listen();
+    void listen(int backlog = 1024);
     int accept(InetAddress *peeraddr);
 
     void shutdownWrite(); // 关闭写端，优雅关闭fd
@@ -26,6 +26,20 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    void setTcpQuickAck(bool on);
+    void setTcpNotSentLowat(int bytes);
+    void setRecvBufferSize(int bytes);
+    void setSendBufferSize(int bytes);
+    void setBusyPoll(int micros);
+    // 开启内核软件接收时间戳（SO_TIMESTAMPING），用Buffer::readFd的rxMicros取出
+    bool setRxTimestamping(bool on);
+    // 只对监听socket有意义
+    void setDeferAccept(int seconds);
+    void setFastOpen(int queueLen);
+
+    // getsockname/getpeername，支持IPv4和Unix域地址
+    static InetAddress getLocalAddr(int sockfd);
+    static InetAddress getPeerAddr(int sockfd);
 
 private:
     const int sockfd_;
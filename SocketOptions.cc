@@ -0,0 +1,78 @@
+#include "SocketOptions.h"
+#include "Socket.h"
+
+SocketOptions SocketOptions::lowLatencyRpc()
+{
+    SocketOptions opts;
+    opts.deferAcceptSeconds = 1; // RPC客户端建连后立即发请求，连接带着数据才交给loop
+    opts.busyPollMicros = 50;
+    opts.tcpNoDelay = true;
+    opts.quickAck = true;
+    return opts;
+}
+
+SocketOptions SocketOptions::bulkTransfer()
+{
+    SocketOptions opts;
+    opts.backlog = 4096;
+    opts.recvBufferSize = 4 * 1024 * 1024;
+    opts.sendBufferSize = 4 * 1024 * 1024;
+    return opts;
+}
+
+void SocketOptions::applyToListener(Socket &socket, bool isTcp) const
+{
+    if(recvBufferSize > 0)
+    {
+        socket.setRecvBufferSize(recvBufferSize);
+    }
+    if(sendBufferSize > 0)
+    {
+        socket.setSendBufferSize(sendBufferSize);
+    }
+    if(busyPollMicros > 0)
+    {
+        socket.setBusyPoll(busyPollMicros);
+    }
+    if(isTcp && deferAcceptSeconds > 0)
+    {
+        socket.setDeferAccept(deferAcceptSeconds);
+    }
+    if(isTcp && fastOpenQueueLen > 0)
+    {
+        socket.setFastOpen(fastOpenQueueLen);
+    }
+}
+
+void SocketOptions::applyToConnection(Socket &socket, bool isTcp) const
+{
+    // 监听socket上已设置的缓冲区大小会被继承，这里对TcpClient发起的连接同样有效
+    if(recvBufferSize > 0)
+    {
+        socket.setRecvBufferSize(recvBufferSize);
+    }
+    if(sendBufferSize > 0)
+    {
+        socket.setSendBufferSize(sendBufferSize);
+    }
+    if(busyPollMicros > 0)
+    {
+        socket.setBusyPoll(busyPollMicros);
+    }
+    if(keepAlive)
+    {
+        socket.setKeepAlive(true);
+    }
+    if(isTcp && tcpNoDelay)
+    {
+        socket.setTcpNoDelay(true);
+    }
+    if(isTcp && quickAck)
+    {
+        socket.setTcpQuickAck(true);
+    }
+    if(isTcp && notSentLowat > 0)
+    {
+        socket.setTcpNotSentLowat(notSentLowat);
+    }
+}
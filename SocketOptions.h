@@ -0,0 +1,51 @@
+#pragma once
+
+class Socket;
+
+// 一组socket选项，由TcpServer/TcpClient::setSocketOptions()设置
+// 监听相关的在Acceptor::listen()时作用于listenfd，连接相关的在每个TcpConnection构造时作用于connfd
+// 数值为0表示不设置，保持内核默认值；默认构造的选项和以前的行为一致（只开SO_KEEPALIVE）
+struct SocketOptions
+{
+    SocketOptions()
+        : backlog(1024)
+        , deferAcceptSeconds(0)
+        , fastOpenQueueLen(0)
+        , recvBufferSize(0)
+        , sendBufferSize(0)
+        , busyPollMicros(0)
+        , notSentLowat(0)
+        , tcpNoDelay(false)
+        , quickAck(false)
+        , keepAlive(true)
+    {}
+
+    // 请求/响应型的小消息：关Nagle、立即ACK、busy poll，收发缓冲区保持默认
+    static SocketOptions lowLatencyRpc();
+    // 大块数据传输：大的收发缓冲区，保留Nagle和延迟ACK
+    static SocketOptions bulkTransfer();
+
+    // 只作用于监听socket
+    int backlog;            // listen()的accept队列长度，受net.core.somaxconn限制
+    int deferAcceptSeconds; // TCP_DEFER_ACCEPT：客户端发来数据后才唤醒accept，最多等这么多秒
+    int fastOpenQueueLen;   // TCP_FASTOPEN：未完成TFO握手的队列长度，需net.ipv4.tcp_fastopen开启服务端支持
+
+    // 监听socket和连接socket都会设置
+    // 收发缓冲区在listen之前设置到监听socket上，accept出的连接继承，SYN中的窗口扩大因子才能按它协商
+    // 设置后内核不再自动调整该连接的缓冲区大小
+    int recvBufferSize;     // SO_RCVBUF
+    int sendBufferSize;     // SO_SNDBUF
+    int busyPollMicros;     // SO_BUSY_POLL：阻塞读时忙等网卡队列的微秒数，需要CAP_NET_ADMIN才能超过sysctl值
+
+    // 只作用于连接socket
+    // TCP_NOTSENT_LOWAT：内核中未发出的数据少于这么多字节时socket才可写
+    // 开启后TcpConnection也只往内核写到这个量，其余留在outputBuffer_中，可以被sendLatest替换
+    int notSentLowat;
+    bool tcpNoDelay;        // TCP_NODELAY：关闭Nagle算法
+    bool quickAck;          // TCP_QUICKACK：内核会自动退出quickack模式，因此每次读之后重新设置
+    bool keepAlive;         // SO_KEEPALIVE
+
+    // TCP专有的选项在isTcp为false（Unix域socket）时跳过
+    void applyToListener(Socket &socket, bool isTcp) const;
+    void applyToConnection(Socket &socket, bool isTcp) const;
+};
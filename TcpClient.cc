@@ -0,0 +1,136 @@
+#include "TcpClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+#include "TcpConnectionPool.h"
+
+#include <strings.h>
+#include <functional>
+#include <sys/socket.h>
+
+static EventLoop* CheckLoopNotNull(EventLoop *loop)
+{
+    if(loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d client loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+// TcpClient析构后连接仍可能存活，关闭时只需在loop中销毁它
+static void detachedRemoveConnection(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+TcpClient::TcpClient(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg)
+                : loop_(CheckLoopNotNull(loop))
+                , connector_(new Connector(loop, serverAddr))
+                , name_(nameArg)
+                , retry_(false)
+                , connect_(false)
+                , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+}
+
+TcpClient::~TcpClient()
+{
+    TcpConnectionPtr conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn = connection_;
+    }
+    if(conn)
+    {
+        // 连接的关闭回调不能再指回本对象
+        CloseCallback cb = std::bind(&detachedRemoveConnection, loop_, std::placeholders::_1);
+        loop_->runInLoop(std::bind(&TcpConnection::setCloseCallback, conn, cb));
+        conn->forceClose();
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect [%s] - connecting to %s \n",
+        name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+
+    if(!callbacks_)
+    {
+        std::shared_ptr<TcpConnectionCallbacks> callbacks = std::make_shared<TcpConnectionCallbacks>();
+        callbacks->namePrefix = name_ + "-" + connector_->serverAddress().toIpPort();
+        callbacks->connectionCallback = connectionCallback_;
+        callbacks->messageCallback = messageCallback_;
+        callbacks->writeCompleteCallback = writeCompleteCallback_;
+        callbacks->closeCallback = std::bind(&TcpClient::removeConnection, this, std::placeholders::_1);
+        callbacks->socketOptions = socketOptions_;
+        callbacks_ = callbacks;
+    }
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+TcpConnectionPtr TcpClient::connection() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connection_;
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    InetAddress peerAddr(connector_->serverAddress());
+    InetAddress localAddr(Socket::getLocalAddr(sockfd));
+
+    // 和服务端一样从本loop线程的对象池创建连接
+    TcpConnectionPtr conn(TcpConnectionPool::forCurrentThread()->create(
+                            loop_,
+                            nextConnId_++,
+                            callbacks_,
+                            sockfd,
+                            localAddr,
+                            peerAddr));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+
+    if(retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::removeConnection [%s] - reconnecting to %s \n",
+            name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
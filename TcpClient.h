@@ -0,0 +1,72 @@
+#pragma once
+// 用户使用muduo编写客户端程序
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "TcpConnection.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class Connector;
+class EventLoop;
+
+// 对外的客户端编程使用的类，一个TcpClient最多同时持有一个连接
+// 连接建立在构造时指定的loop上，得到的是和服务端一样的TcpConnection
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg);
+    // 必须在loop线程中析构，或在loop退出之后析构
+    ~TcpClient();
+
+    void connect();
+    // 关闭当前连接，数据发完后断开
+    void disconnect();
+    // 停止正在进行的连接/重试
+    void stop();
+
+    // 当前连接，未连接时为空，可在任意线程调用
+    TcpConnectionPtr connection() const;
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+
+    // 连接断开后自动重连
+    void enableRetry() { retry_ = true; }
+    bool retry() const { return retry_; }
+
+    // 下面的回调须在connect()之前设置，connect()时生成连接使用的回调表
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 连接socket的选项，监听相关的字段不起作用
+    void setSocketOptions(const SocketOptions &opts) { socketOptions_ = opts; }
+
+private:
+    // Connector连接成功后在loop线程中调用
+    void newConnection(int sockfd);
+    // 在loop线程中移除连接，需要时重连
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    std::shared_ptr<Connector> connector_;
+    const std::string name_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    SocketOptions socketOptions_;
+    TcpConnectionCallbacksPtr callbacks_; // 本客户端各次连接共享的回调表
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    uint64_t nextConnId_; // 只在loop线程中递增
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 受mutex_保护
+};
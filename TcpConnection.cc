@@ -1,8 +1,11 @@
 #include "TcpConnection.h"
+#include "TcpConnectionPool.h"
 #include "Logger.h"
-#include "Socket.h"
-#include "Channel.h"
 #include "EventLoop.h"
+#include "Timer.h"
+#include "TokenBucket.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 #include <functional>
 #include <errno.h>
@@ -10,7 +13,14 @@
 #include <sys/socket.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 #include <string>
+#include <float.h>
+#include <stdint.h>
+
+// 限速暂停后，至少等攒够这么多字节的令牌再恢复，避免频繁的小块读写和定时器
+static const double kShapingChunk = 4096.0;
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -22,43 +32,103 @@ static EventLoop* CheckLoopNotNull(EventLoop *loop)
 }
 
 TcpConnection::TcpConnection(EventLoop *loop,
-                const std::string &nameArg,
+                uint64_t connId,
+                const TcpConnectionCallbacksPtr &callbacks,
                 int sockfd,
                 const InetAddress& localAddr,
-                const InetAddress& peerAddr)
+                const InetAddress& peerAddr,
+                TcpConnectionPool *pool)
     : loop_(CheckLoopNotNull(loop))
-    , name_(nameArg)
+    , id_(connId)
     , state_(kConnecting)
     , reading_(true)
-    , socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd))
+    , socket_(sockfd)
+    , channel_(loop, sockfd)
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
+    , callbacks_(callbacks ? callbacks : std::make_shared<const TcpConnectionCallbacks>())
+    , ownsCallbacks_(false)
     , highWaterMark_(64*1024*1024) // 64M
+    , notSentLowat_(0)
+    , replaceableBytes_(0)
+    , readThrottled_(false)
+    , writeThrottled_(false)
+    , pool_(pool)
+    , inputBuffer_(pool ? pool->takeBuffer() : Buffer())
+    , outputBuffer_(0) // 只有内核发送缓冲区满时才用到，按需扩容
 {
-    // 给channel设置相应回调
-    // Poller 给 Channel通知感兴趣的事件发生，Channel会回调相应操作函数
-    channel_->setReadCallback(
-        std::bind(&TcpConnection::handleRead, this, std::placeholders::_1)
-    );
-    channel_->setWriteCallback(
-        std::bind(&TcpConnection::handleWrite, this)
-    );
-    channel_->setCloseCallback(
-        std::bind(&TcpConnection::handleClose, this)
-    );
-    channel_->setErrorCallback(
-        std::bind(&TcpConnection::handleError, this)
-    );
-
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    // Poller 给 Channel通知感兴趣的事件发生，Channel直接调用本对象的handleXxx
+    channel_.setHandler(this);
+
+    LOG_DEBUG("TcpConnection::ctor[%s] at fd=%d\n", name().c_str(), sockfd);
+    callbacks_->socketOptions.applyToConnection(socket_, !localAddr_.isUnix());
+    if(!localAddr_.isUnix() && callbacks_->socketOptions.notSentLowat > 0)
+    {
+        notSentLowat_ = callbacks_->socketOptions.notSentLowat;
+    }
+    if(callbacks_->trackLatency)
+    {
+        latency_.reset(new ConnectionLatency);
+        // Unix域socket没有接收时间戳，只缺kKernelToPoll一项
+        if(!localAddr_.isUnix())
+        {
+            socket_.setRxTimestamping(true);
+        }
+    }
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n",
-     name_.c_str(), channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::dtor[%s] at fd=%d state=%d\n",
+     name().c_str(), channel_.fd(), (int)state_);
+    if(pool_)
+    {
+        pool_->recycleBuffer(std::move(inputBuffer_));
+    }
+}
+
+std::string TcpConnection::name() const
+{
+    char buf[32] = {0};
+    snprintf(buf, sizeof buf, "#%llu", static_cast<unsigned long long>(id_));
+    return (callbacks_->namePrefix.empty() ? std::string("TcpConnection") : callbacks_->namePrefix) + buf;
+}
+
+TcpConnectionCallbacks& TcpConnection::mutableCallbacks()
+{
+    if(!ownsCallbacks_)
+    {
+        callbacks_ = std::make_shared<TcpConnectionCallbacks>(*callbacks_);
+        ownsCallbacks_ = true;
+    }
+    // 私有的拷贝只有本连接引用，可以修改
+    return const_cast<TcpConnectionCallbacks&>(*callbacks_);
+}
+
+void TcpConnection::setConnectionCallback(const ConnectionCallback& cb)
+{
+    mutableCallbacks().connectionCallback = cb;
+}
+
+void TcpConnection::setMessageCallback(const MessageCallback &cb)
+{
+    mutableCallbacks().messageCallback = cb;
+}
+
+void TcpConnection::setWriteCompleteCallback(const WriteCompleteCallback &cb)
+{
+    mutableCallbacks().writeCompleteCallback = cb;
+}
+
+void TcpConnection::setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
+{
+    mutableCallbacks().highWaterMarkCallback = cb;
+    highWaterMark_ = highWaterMark;
+}
+
+void TcpConnection::setCloseCallback(const CloseCallback& cb)
+{
+    mutableCallbacks().closeCallback = cb;
 }
 
 void TcpConnection::send(const std::string &buf)
@@ -71,18 +141,84 @@ void TcpConnection::send(const std::string &buf)
         }
         else  // 唤醒Loop所属线程执行send
         {
-            loop_->runInLoop(
-                std::bind(
-                    &TcpConnection::sendInLoop,
-                    this,
-                    buf.c_str(),
-                    buf.size()
-                )
-            );
+            // 调用者的buf在任务执行前可能已经释放，拷贝一份并保活连接
+            std::shared_ptr<std::string> data(std::make_shared<std::string>(buf));
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, data]() {
+                self->sendInLoop(data->data(), data->size());
+            });
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if(state_ == kConnected)
+    {
+        if(loop_->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retriveAll();
+        }
+        else
+        {
+            // 跨线程时buf可能在发送前被修改，拷贝一份随任务带过去
+            std::shared_ptr<std::string> data(std::make_shared<std::string>(buf->retriveAllAsString()));
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, data]() {
+                self->sendInLoop(data->data(), data->size());
+            });
         }
     }
 }
 
+void TcpConnection::sendLatest(const std::string &message)
+{
+    if(state_ == kConnected)
+    {
+        if(loop_->isInLoopThread())
+        {
+            sendLatestInLoop(message.data(), message.size());
+        }
+        else
+        {
+            std::shared_ptr<std::string> data(std::make_shared<std::string>(message));
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, data]() {
+                self->sendLatestInLoop(data->data(), data->size());
+            });
+        }
+    }
+}
+
+void TcpConnection::sendLatestInLoop(const void* data, size_t len)
+{
+    if(replaceableBytes_ > 0)
+    {
+        // 上一条还完整地留在outputBuffer_末尾，已经过时，丢掉
+        outputBuffer_.unwrite(replaceableBytes_);
+        replaceableBytes_ = 0;
+    }
+    size_t oldLen = outputBuffer_.readableBytes();
+    sendInLoop(data, len);
+    // 一个字节都没写进内核时才能被下一条替换，写出一部分的必须发完，否则破坏消息边界
+    if(len > 0 && outputBuffer_.readableBytes() == oldLen + len)
+    {
+        replaceableBytes_ = len;
+    }
+}
+
+size_t TcpConnection::notSentAllowance() const
+{
+    int unsent = 0;
+    if(::ioctl(channel_.fd(), SIOCOUTQNSD, &unsent) < 0)
+    {
+        return SIZE_MAX; // 取不到就不限制
+    }
+    size_t queued = static_cast<size_t>(unsent);
+    return queued < notSentLowat_ ? notSentLowat_ - queued : 0;
+}
+
 // 发送数据时，若应用写的快，内核发送满
 // 需要把待发送数据写入缓冲区中
 // 且设置了水位回调
@@ -98,27 +234,62 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         LOG_ERROR("disconnected, give up writing!");
         return;
     }
+    // 新数据排在后面，outputBuffer_末尾不再是可替换的最新值
+    replaceableBytes_ = 0;
 
     // !!if no thing in output queue, try writing directly
     // 表示channel_第一次开始写数据， 且缓冲区无待发数据,则可以直接发data数据
     // 否则要将数据加入到 outputBuffer_ 后发送
-    if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if(!channel_.isWriting() && !writeThrottled_ && outputBuffer_.readableBytes() == 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        size_t maxBytes = len;
+        int64_t now = 0;
+        if(writeShaped())
+        {
+            now = Timer::now();
+            maxBytes = std::min(len, allowance(writeLimit_.get(), callbacks_->sharedWriteLimit, now));
+        }
+        // 内核里未发出的数据够多了就不再写，留在outputBuffer_中等EPOLLOUT
+        if(notSentLowat_ > 0 && maxBytes > 0)
+        {
+            maxBytes = std::min(maxBytes, notSentAllowance());
+        }
+        // 限速的令牌用完了或内核积压已满就不直接写，全部放入outputBuffer_
+        if(latency_)
+        {
+            latency_->sent = true;
+        }
+        nwrote = maxBytes > 0 ? ::write(channel_.fd(), data, maxBytes) : 0;
+        MYMUDUO_PROBE2(write, channel_.fd(), nwrote);
+        if(nwrote > 0)
+        {
+            if(now != 0)
+            {
+                consume(writeLimit_.get(), callbacks_->sharedWriteLimit, nwrote, now);
+            }
+            if(callbacks_->metrics)
+            {
+                callbacks_->metrics->bytesWritten.add(nwrote);
+            }
+        }
         if(nwrote >= 0)
         {
             remaining = len - nwrote;
-            if(remaining == 0 && writeCompleteCallback_)
+            if(remaining == 0 && callbacks_->writeCompleteCallback)
             {
                 // 数据全部发完，不用给channel设置epollout事件
                 loop_->queueInLoop(
-                    std::bind(writeCompleteCallback_, shared_from_this())
+                    std::bind(callbacks_->writeCompleteCallback, shared_from_this())
                 );
             }
         }
         else 
         {
             nwrote = 0;
+            if(errno == EWOULDBLOCK)
+            {
+                MYMUDUO_PROBE2(write_eagain, channel_.fd(), len);
+            }
             // EWOULDBLOCK没有数据的正常返回
             if(errno != EWOULDBLOCK)
             {
@@ -139,18 +310,39 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     {
         // 目前发送缓冲区剩余待发送数据长度
         size_t oldLen = outputBuffer_.readableBytes();
-        if(oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_  // 上一次若已经超过高水位，不需要调用回调
-            && highWaterMarkCallback_)
+        bool crossHighWaterMark = oldLen + remaining >= highWaterMark_
+            && oldLen < highWaterMark_;  // 上一次若已经超过高水位，不需要调用回调
+        if(crossHighWaterMark)
+        {
+            MYMUDUO_PROBE2(high_water_mark, id_, oldLen + remaining);
+        }
+        if(crossHighWaterMark && callbacks_->highWaterMarkCallback)
         {
             loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining)
+                std::bind(callbacks_->highWaterMarkCallback, shared_from_this(), oldLen + remaining)
             );
         }
+        if(callbacks_->metrics)
+        {
+            callbacks_->metrics->bytesQueued.add(remaining);
+            if(crossHighWaterMark)
+            {
+                callbacks_->metrics->highWaterMarkHits.increment();
+            }
+        }
+        if(latency_)
+        {
+            latency_->sent = true;
+            if(oldLen == 0)
+            {
+                latency_->queuedSince = Timestamp::now().microSecondsSinceEpoch();
+            }
+        }
         outputBuffer_.append((char*)data + nwrote, remaining);
-        if(!channel_->isWriting())
+        // 限速暂停期间由定时器恢复写事件
+        if(!channel_.isWriting() && !writeThrottled_)
         {
-            channel_->enableWriting(); // 一定要注册channel写事件，否则poller不会给channel通知epollout
+            channel_.enableWriting(); // 一定要注册channel写事件，否则poller不会给channel通知epollout
         }
     }
 }
@@ -170,9 +362,30 @@ void TcpConnection::shutdownInLoop()
 {
     // 保证优雅关闭，发完数据才关闭
     // 不关注channel_的写事件了，表明outputBuffer中数据已全部发送完成
-    if(!channel_->isWriting())
+    // 限速暂停写时outputBuffer中还有数据，等恢复后发完再关闭
+    if(!channel_.isWriting() && !writeThrottled_)
     {
-        socket_->shutdownWrite();
+        socket_.shutdownWrite();
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 放到本轮回调之后执行，调用者可能正在遍历连接
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this())
+        );
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
     }
 }
 
@@ -181,32 +394,105 @@ void TcpConnection::connectEstablished()
     setState(kConnected);
     // 检测Channel对应的TcpConnection的生命期
     // 防止对应的Channel在销毁后仍被调用其回调
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向Poller注册Channel的epollin事件
+    channel_.tie(shared_from_this());
+    channel_.enableReading(); // 向Poller注册Channel的epollin事件
+    MYMUDUO_PROBE2(conn_established, id_, channel_.fd());
 
     // 新连接建立，执行回调
-    connectionCallback_(shared_from_this()); // 用户定义的函数
+    if(callbacks_->connectionCallback)
+    {
+        callbacks_->connectionCallback(shared_from_this()); // 用户定义的函数
+    }
 }
 
 void TcpConnection::connectDestroyed()
 {
+    MYMUDUO_PROBE2(conn_destroyed, id_, channel_.fd());
     if(state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll(); // 把对channel所有感兴趣的事件从Poller中删除掉
-        connectionCallback_(shared_from_this()); //用户设置的回调
+        channel_.disableAll(); // 把对channel所有感兴趣的事件从Poller中删除掉
+        if(callbacks_->connectionCallback)
+        {
+            callbacks_->connectionCallback(shared_from_this()); //用户设置的回调
+        }
     }
-    channel_->remove(); // 把channel从Poller中删掉（从map中删掉）
+    channel_.remove(); // 把channel从Poller中删掉（从map中删掉）
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    size_t maxBytes = SIZE_MAX;
+    int64_t now = 0;
+    if(readShaped())
+    {
+        now = Timer::now();
+        maxBytes = allowance(readLimit_.get(), callbacks_->sharedReadLimit, now);
+        if(maxBytes == 0)
+        {
+            throttleReading(now);
+            return;
+        }
+    }
+
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    int64_t rxMicros = 0;
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno, maxBytes,
+                                    latency_ && !localAddr_.isUnix() ? &rxMicros : nullptr);
+    int64_t callbackStart = 0;
+    if(latency_ && n > 0)
+    {
+        // 精度就是pollReturnTime的微秒精度
+        int64_t pollTime = receiveTime.microSecondsSinceEpoch();
+        callbackStart = Timestamp::now().microSecondsSinceEpoch();
+        if(rxMicros != 0)
+        {
+            recordLatency(ConnectionLatency::kKernelToPoll, pollTime - rxMicros);
+        }
+        recordLatency(ConnectionLatency::kPollToRead, callbackStart - pollTime);
+        latency_->sent = false;
+    }
     if(n > 0)
     {
+        if(now != 0)
+        {
+            consume(readLimit_.get(), callbacks_->sharedReadLimit, n, now);
+        }
+        if(callbacks_->metrics)
+        {
+            callbacks_->metrics->bytesRead.add(n);
+        }
+        // 内核在发出几个ACK后会回到延迟ACK模式，每次读到数据后重新打开
+        if(callbacks_->socketOptions.quickAck && !localAddr_.isUnix())
+        {
+            socket_.setTcpQuickAck(true);
+        }
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        if(callbacks_->messageCallback)
+        {
+            callbacks_->messageCallback(shared_from_this(), &inputBuffer_, receiveTime);
+        }
+        else
+        {
+            inputBuffer_.retriveAll();
+        }
+        if(latency_)
+        {
+            int64_t now = Timestamp::now().microSecondsSinceEpoch();
+            recordLatency(ConnectionLatency::kCallback, now - callbackStart);
+            if(latency_->sent)
+            {
+                if(outputBuffer_.readableBytes() == 0)
+                {
+                    recordLatency(ConnectionLatency::kWriteComplete, now - receiveTime.microSecondsSinceEpoch());
+                }
+                else if(latency_->requestStart == 0)
+                {
+                    // 等outputBuffer_发完再算，之前还有没发完的请求时按更早的那个算
+                    latency_->requestStart = receiveTime.microSecondsSinceEpoch();
+                }
+            }
+        }
     }
     else if(n == 0) // 连接断开
     {
@@ -222,22 +508,72 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 
 void TcpConnection::handleWrite()
 {
-    if(channel_->isWriting())
+    if(channel_.isWriting())
     {
+        size_t maxBytes = SIZE_MAX;
+        int64_t now = 0;
+        if(writeShaped())
+        {
+            now = Timer::now();
+            maxBytes = allowance(writeLimit_.get(), callbacks_->sharedWriteLimit, now);
+            if(maxBytes == 0)
+            {
+                channel_.disableWriting();
+                throttleWriting(now);
+                return;
+            }
+        }
+        // 设置了TCP_NOTSENT_LOWAT时EPOLLOUT表示内核积压已低于阈值，只补到阈值为止
+        if(notSentLowat_ > 0)
+        {
+            maxBytes = std::min(maxBytes, notSentAllowance());
+            if(maxBytes == 0)
+            {
+                return;
+            }
+        }
+
         int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), &savedErrno, maxBytes);
         if(n > 0)
         {
+            if(now != 0)
+            {
+                consume(writeLimit_.get(), callbacks_->sharedWriteLimit, n, now);
+            }
+            if(callbacks_->metrics)
+            {
+                callbacks_->metrics->bytesWritten.add(n);
+            }
             outputBuffer_.retrieve(n);
+            // 可替换的最新值已经写出一部分，不能再替换
+            if(outputBuffer_.readableBytes() < replaceableBytes_)
+            {
+                replaceableBytes_ = 0;
+            }
             // 缓冲区内数据都发出了，则不需要再关注fd的可写事件了
             if(outputBuffer_.readableBytes() == 0)
             {
-                channel_->disableWriting();
-                if(writeCompleteCallback_)
+                if(latency_)
+                {
+                    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+                    if(latency_->queuedSince != 0)
+                    {
+                        recordLatency(ConnectionLatency::kOutputQueued, now - latency_->queuedSince);
+                        latency_->queuedSince = 0;
+                    }
+                    if(latency_->requestStart != 0)
+                    {
+                        recordLatency(ConnectionLatency::kWriteComplete, now - latency_->requestStart);
+                        latency_->requestStart = 0;
+                    }
+                }
+                channel_.disableWriting();
+                if(callbacks_->writeCompleteCallback)
                 {
                     // 唤醒loop_对应线程执行回调
                     loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this())
+                        std::bind(callbacks_->writeCompleteCallback, shared_from_this())
                     );
                 }
                 if(state_ == kDisconnecting) // 保证优雅关闭
@@ -253,20 +589,47 @@ void TcpConnection::handleWrite()
     }
     else
     {
-        LOG_ERROR("TcpConnection fd=%d is down no more writing \n", channel_->fd());
+        LOG_ERROR("TcpConnection fd=%d is down no more writing \n", channel_.fd());
     }
 
 }
 
+bool TcpConnection::tcpInfo(TcpInfo *info) const
+{
+    if(localAddr_.isUnix() || !TcpInfo::sample(channel_.fd(), info))
+    {
+        return false;
+    }
+    info->outputBufferBytes = outputBuffer_.readableBytes();
+    return true;
+}
+
+void TcpConnection::recordLatency(int phase, int64_t micros)
+{
+    // 时钟被向回调整时不记负数
+    micros = std::max<int64_t>(micros, 0);
+    latency_->stats[phase].add(micros);
+    if(callbacks_->metrics)
+    {
+        callbacks_->metrics->latency[phase].observe(static_cast<uint64_t>(micros));
+    }
+}
+
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd = %d state=%d\n", channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::handleClose fd = %d state=%d\n", channel_.fd(), (int)state_);
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr); //
-    closeCallback_(connPtr); // 关闭连接的回调 执行的是TcpServer::removeConnection回调方法
+    if(callbacks_->connectionCallback)
+    {
+        callbacks_->connectionCallback(connPtr);
+    }
+    if(callbacks_->closeCallback)
+    {
+        callbacks_->closeCallback(connPtr); // 关闭连接的回调 执行的是TcpServer::removeConnection回调方法
+    }
 }
 
 void TcpConnection::handleError()
@@ -275,7 +638,7 @@ void TcpConnection::handleError()
     socklen_t optlen = sizeof optval;
     int err = 0;
     // 获得错误码信息
-    if(::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if(::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -284,5 +647,132 @@ void TcpConnection::handleError()
         err = optval;
     }
 
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n",name_.c_str(), err);
-}
\ No newline at end of file
+    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name().c_str(), err);
+}
+
+void TcpConnection::setReadRateLimit(double bytesPerSecond, double burst)
+{
+    loop_->runInLoop(std::bind(&TcpConnection::setRateLimitInLoop, shared_from_this(), true, bytesPerSecond, burst));
+}
+
+void TcpConnection::setWriteRateLimit(double bytesPerSecond, double burst)
+{
+    loop_->runInLoop(std::bind(&TcpConnection::setRateLimitInLoop, shared_from_this(), false, bytesPerSecond, burst));
+}
+
+void TcpConnection::setRateLimitInLoop(bool read, double bytesPerSecond, double burst)
+{
+    std::unique_ptr<TokenBucket> &limit = read ? readLimit_ : writeLimit_;
+    if(bytesPerSecond <= 0.0)
+    {
+        limit.reset();
+    }
+    else
+    {
+        limit.reset(new TokenBucket(bytesPerSecond, burst));
+    }
+}
+
+size_t TcpConnection::allowance(TokenBucket *own, TokenBucket *shared, int64_t now)
+{
+    double avail = DBL_MAX;
+    if(own != nullptr && !own->unlimited())
+    {
+        avail = std::min(avail, own->available(now));
+    }
+    if(shared != nullptr && !shared->unlimited())
+    {
+        avail = std::min(avail, shared->available(now));
+    }
+    if(avail >= static_cast<double>(SIZE_MAX))
+    {
+        return SIZE_MAX;
+    }
+    return avail < 1.0 ? 0 : static_cast<size_t>(avail);
+}
+
+void TcpConnection::consume(TokenBucket *own, TokenBucket *shared, size_t n, int64_t now)
+{
+    if(own != nullptr)
+    {
+        own->consume(static_cast<double>(n), now);
+    }
+    if(shared != nullptr)
+    {
+        shared->consume(static_cast<double>(n), now);
+    }
+}
+
+// 两个令牌桶都攒够一块数据所需的时间
+static double throttleDelay(TokenBucket *own, TokenBucket *shared, int64_t now)
+{
+    int64_t delay = 0;
+    if(own != nullptr && !own->unlimited())
+    {
+        delay = std::max(delay, own->delayFor(std::min(kShapingChunk, own->burst()), now));
+    }
+    if(shared != nullptr && !shared->unlimited())
+    {
+        delay = std::max(delay, shared->delayFor(std::min(kShapingChunk, shared->burst()), now));
+    }
+    return static_cast<double>(delay) / Timer::kMicroSecondsPerSecond;
+}
+
+void TcpConnection::throttleReading(int64_t now)
+{
+    readThrottled_ = true;
+    channel_.disableReading();
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    loop_->runAfter(throttleDelay(readLimit_.get(), callbacks_->sharedReadLimit, now), [weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if(conn)
+        {
+            conn->resumeReading();
+        }
+    });
+}
+
+void TcpConnection::resumeReading()
+{
+    if(readThrottled_)
+    {
+        readThrottled_ = false;
+        if(state_ == kConnected || state_ == kDisconnecting)
+        {
+            channel_.enableReading();
+        }
+    }
+}
+
+// 调用前outputBuffer_中必须有待发送的数据
+void TcpConnection::throttleWriting(int64_t now)
+{
+    writeThrottled_ = true;
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    loop_->runAfter(throttleDelay(writeLimit_.get(), callbacks_->sharedWriteLimit, now), [weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if(conn)
+        {
+            conn->resumeWriting();
+        }
+    });
+}
+
+void TcpConnection::resumeWriting()
+{
+    if(writeThrottled_)
+    {
+        writeThrottled_ = false;
+        if(state_ == kConnected || state_ == kDisconnecting)
+        {
+            if(outputBuffer_.readableBytes() > 0)
+            {
+                channel_.enableWriting();
+            }
+            else if(state_ == kDisconnecting)
+            {
+                shutdownInLoop();
+            }
+        }
+    }
+}
@@ -4,31 +4,41 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "ConnectionLatency.h"
+#include "TcpInfo.h"
 
 #include <atomic>
 #include <memory>
 #include <string>
 
-class Channel;
 class EventLoop;
-class Socket;
+class TcpConnectionPool;
+class TokenBucket;
 
 // TcpServer -> Acceptor -> 有一个新用户连接，通过accept得到connfd
 // -> TcpConnection 设置回调 -> Channel -> Poller -> Channel的回调操作
 // 对 成功与服务器建立连接所得的connfd的封装
-class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
+class TcpConnection : noncopyable,
+                      public std::enable_shared_from_this<TcpConnection>,
+                      private ChannelHandler
 {
 public:
     TcpConnection(EventLoop *loop,
-                const std::string &nameArg,
+                uint64_t connId,
+                const TcpConnectionCallbacksPtr &callbacks,
                 int sockfd,
                 const InetAddress& localAddr,
-                const InetAddress& peerAddr);
+                const InetAddress& peerAddr,
+                TcpConnectionPool *pool = nullptr);
     ~TcpConnection();
 
     EventLoop* getLoop() const { return loop_; }
-    // getLoopName
-    const std::string& name() const { return name_; }
+    // 连接的唯一id，TcpServer内部以此作为连接表的key
+    uint64_t id() const { return id_; }
+    // 连接名按需格式化为 前缀#id，只在打日志等需要时才生成字符串
+    std::string name() const;
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
 
@@ -36,18 +46,41 @@ public:
 
     // 发送数据
     void send(const std::string &buf);
+    // 发送buf中全部可读数据并清空buf，在loop线程中调用时不产生额外拷贝
+    void send(Buffer *buf);
+    // 发送"最新值"：上一次sendLatest的数据若还整条留在outputBuffer_中没发出，直接用这次的替换掉
+    // 适合行情这类只关心最新状态的推送；配合SocketOptions::notSentLowat，未发出的数据才会留在用户态
+    void sendLatest(const std::string &message);
     // 关闭连接
     void shutdown();
+    // 不等待数据发完，直接关闭连接
+    void forceClose();
 
-    void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setTcpNoDelay(bool on) { socket_.setTcpNoDelay(on); }
 
-    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    // 现在读取一次内核中的TCP状态（TCP_INFO）和outputBuffer_积压，Unix域连接返回false
+    // 只能在loop线程中调用，其他线程可以runInLoop后再调用
+    bool tcpInfo(TcpInfo *info) const;
+
+    // 开启延迟跟踪（TcpServer::enableLatencyTracking）时返回本连接各阶段的耗时统计，否则为空
+    // 只能在loop线程中读取
+    const ConnectionLatency* latency() const { return latency_.get(); }
+
+    // 本连接的收/发限速（字节/秒），允许burst字节的突发，rate <= 0 取消限速
+    // 和TcpServer按subLoop分摊的总限速同时生效，可在任意线程调用
+    void setReadRateLimit(double bytesPerSecond, double burst = 0.0);
+    void setWriteRateLimit(double bytesPerSecond, double burst = 0.0);
+
+    // 下面的设置只影响当前连接：先拷贝一份共享回调表再修改（写时复制）
+    void setConnectionCallback(const ConnectionCallback& cb);
+
+    void setMessageCallback(const MessageCallback &cb);
     
-    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb);
     
-    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark) { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark);
 
-    void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
+    void setCloseCallback(const CloseCallback& cb);
 
     // 连接建立
     void connectEstablished();
@@ -58,33 +91,66 @@ private:
     enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
     void setState(StateE state) { state_ = state; }
 
-    void handleRead(Timestamp receiveTime);
-    void handleWrite();
-    void handleClose();
-    void handleError();
+    // ChannelHandler，由channel_直接分发
+    void handleRead(Timestamp receiveTime) override;
+    void handleWrite() override;
+    void handleClose() override;
+    void handleError() override;
+    std::string handlerName() const override { return name(); }
+
+    // 返回一份只属于本连接的回调表，用于修改
+    TcpConnectionCallbacks& mutableCallbacks();
 
     void sendInLoop(const void* message, size_t len);
+    void sendLatestInLoop(const void* message, size_t len);
+    // TCP_NOTSENT_LOWAT模式下这次最多还能往内核写多少字节
+    size_t notSentAllowance() const;
     void shutdownInLoop();
+    // 记录一次阶段耗时到本连接和所属分片的直方图
+    void recordLatency(int phase, int64_t micros);
+    void forceCloseInLoop();
+
+    // 限速：令牌不足时暂停关注EPOLLIN/EPOLLOUT，由loop的定时器恢复，不阻塞线程
+    void setRateLimitInLoop(bool read, double bytesPerSecond, double burst);
+    bool readShaped() const { return readLimit_ || callbacks_->sharedReadLimit; }
+    bool writeShaped() const { return writeLimit_ || callbacks_->sharedWriteLimit; }
+    // 这一次最多允许读/写的字节数，0表示需要暂停
+    static size_t allowance(TokenBucket *own, TokenBucket *shared, int64_t now);
+    static void consume(TokenBucket *own, TokenBucket *shared, size_t n, int64_t now);
+    void throttleReading(int64_t now);
+    void resumeReading();
+    void throttleWriting(int64_t now);
+    void resumeWriting();
     
     EventLoop *loop_; // 不是baseLoop，因为 TcpConnection都是在subLoop中管理
-    const std::string name_;
+    const uint64_t id_;
+
     std::atomic_int state_;
     bool reading_;
 
     // 与Acceptor类似， Acceptor -> mainLoop , TcpConnection -> subLoop
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 直接内嵌，和TcpConnection一起分配
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
 
-    ConnectionCallback connectionCallback_;
-    MessageCallback messageCallback_; // 有读写消息时的回调
-    WriteCompleteCallback writeCompleteCallback_;
-    HighWaterMarkCallback highWaterMarkCallback_;
-    CloseCallback closeCallback_;
+    TcpConnectionCallbacksPtr callbacks_; // 同一TcpServer同一subLoop的连接共享
+    bool ownsCallbacks_; // callbacks_是否已拷贝为本连接私有
     size_t highWaterMark_;
+    size_t notSentLowat_;     // 0表示不限制内核中未发出的数据量
+    size_t replaceableBytes_; // outputBuffer_末尾可被sendLatest替换的字节数
+
+    // 本连接的限速，设置时才创建
+    std::unique_ptr<TokenBucket> readLimit_;
+    std::unique_ptr<TokenBucket> writeLimit_;
+    bool readThrottled_;  // 因限速暂停了读
+    bool writeThrottled_; // 因限速暂停了写
+
+    std::unique_ptr<ConnectionLatency> latency_; // 开启延迟跟踪时才创建
 
+    TcpConnectionPool *pool_; // 由对象池创建时非空，析构时把inputBuffer_还给池
     Buffer inputBuffer_; // 接收数据的缓冲区
     Buffer outputBuffer_; // 发送数据的缓冲区
 };
\ No newline at end of file
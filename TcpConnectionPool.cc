@@ -0,0 +1,102 @@
+#include "TcpConnectionPool.h"
+#include "TcpConnection.h"
+#include "CurrentThread.h"
+
+#include <new>
+
+const size_t TcpConnectionPool::kMaxFreeBlocks;
+const size_t TcpConnectionPool::kMaxFreeBuffers;
+const size_t TcpConnectionPool::kMaxBufferCapacity;
+
+// 线程退出时释放本线程的池，池中仍被连接引用的部分由连接的控制块保活
+const std::shared_ptr<TcpConnectionPool>& TcpConnectionPool::forCurrentThread()
+{
+    static thread_local std::shared_ptr<TcpConnectionPool> t_pool(new TcpConnectionPool());
+    return t_pool;
+}
+
+TcpConnectionPool::TcpConnectionPool()
+    : threadId_(CurrentThread::tid())
+    , blockSize_(0)
+{
+}
+
+TcpConnectionPool::~TcpConnectionPool()
+{
+    for(void *block : freeBlocks_)
+    {
+        ::operator delete(block);
+    }
+}
+
+TcpConnectionPtr TcpConnectionPool::create(EventLoop *loop,
+                                           uint64_t connId,
+                                           const TcpConnectionCallbacksPtr &callbacks,
+                                           int sockfd,
+                                           const InetAddress &localAddr,
+                                           const InetAddress &peerAddr)
+{
+    // 对象和控制块一次分配
+    return std::allocate_shared<TcpConnection>(
+        PoolAllocator<TcpConnection>(shared_from_this()),
+        loop, connId, callbacks, sockfd, localAddr, peerAddr, this);
+}
+
+bool TcpConnectionPool::inOwnerThread() const
+{
+    return threadId_ == CurrentThread::tid();
+}
+
+void* TcpConnectionPool::allocate(size_t size)
+{
+    if(inOwnerThread())
+    {
+        if(blockSize_ == 0)
+        {
+            blockSize_ = size;
+        }
+        if(size == blockSize_ && !freeBlocks_.empty())
+        {
+            void *block = freeBlocks_.back();
+            freeBlocks_.pop_back();
+            return block;
+        }
+    }
+    return ::operator new(size);
+}
+
+void TcpConnectionPool::deallocate(void *p, size_t size)
+{
+    // 每个内存块都是单独从operator new分配的，不回收时可以直接归还
+    if(inOwnerThread() && size == blockSize_ && freeBlocks_.size() < kMaxFreeBlocks)
+    {
+        freeBlocks_.push_back(p);
+    }
+    else
+    {
+        ::operator delete(p);
+    }
+}
+
+Buffer TcpConnectionPool::takeBuffer()
+{
+    if(inOwnerThread() && !freeBuffers_.empty())
+    {
+        Buffer buf(std::move(freeBuffers_.back()));
+        freeBuffers_.pop_back();
+        return buf;
+    }
+    return Buffer();
+}
+
+void TcpConnectionPool::recycleBuffer(Buffer &&buf)
+{
+    // 读写过大数据的Buffer不缓存，避免空闲连接占着大块内存
+    if(inOwnerThread()
+        && freeBuffers_.size() < kMaxFreeBuffers
+        && buf.internalCapacity() <= kMaxBufferCapacity)
+    {
+        buf.retriveAll();
+        freeBuffers_.push_back(std::move(buf));
+    }
+}
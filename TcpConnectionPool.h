@@ -0,0 +1,86 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+class EventLoop;
+class InetAddress;
+
+// 每个loop线程一个TcpConnection对象池（one loop per thread，即每个loop一个）
+// 1. TcpConnection和shared_ptr控制块用allocate_shared一次分配，释放后内存块留在池中复用
+// 2. 连接析构时把接收Buffer的底层内存交还给池，下一个连接直接接管
+// 只有池所属线程会复用内存，其他线程释放连接时退回给全局operator delete
+class TcpConnectionPool : noncopyable, public std::enable_shared_from_this<TcpConnectionPool>
+{
+public:
+    static const size_t kMaxFreeBlocks = 4096;   // 池中最多缓存的对象内存块
+    static const size_t kMaxFreeBuffers = 8192;  // 池中最多缓存的Buffer
+    static const size_t kMaxBufferCapacity = 64 * 1024; // 超过该容量的Buffer不回收
+
+    // 当前线程的对象池，第一次调用时创建
+    static const std::shared_ptr<TcpConnectionPool>& forCurrentThread();
+
+    ~TcpConnectionPool();
+
+    // 在当前loop线程中创建一个池化的TcpConnection
+    TcpConnectionPtr create(EventLoop *loop,
+                            uint64_t connId,
+                            const TcpConnectionCallbacksPtr &callbacks,
+                            int sockfd,
+                            const InetAddress &localAddr,
+                            const InetAddress &peerAddr);
+
+    // 供PoolAllocator调用
+    void* allocate(size_t size);
+    void deallocate(void *p, size_t size);
+
+    // 取出一个缓存的Buffer，没有则新建 / 把不再使用的Buffer交还给池
+    Buffer takeBuffer();
+    void recycleBuffer(Buffer &&buf);
+
+    size_t freeBlocks() const { return freeBlocks_.size(); }
+    size_t freeBuffers() const { return freeBuffers_.size(); }
+
+private:
+    TcpConnectionPool();
+
+    bool inOwnerThread() const;
+
+    const pid_t threadId_; // 池所属的loop线程
+    size_t blockSize_;     // TcpConnection+控制块的大小，第一次分配时确定
+    std::vector<void*> freeBlocks_;
+    std::vector<Buffer> freeBuffers_;
+};
+
+// allocate_shared使用的分配器，持有池的shared_ptr，保证池比它分配的对象活得久
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(const std::shared_ptr<TcpConnectionPool> &pool) : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool_) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(pool_->allocate(n * sizeof(T))); }
+    void deallocate(T *p, size_t n) { pool_->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    struct rebind { using other = PoolAllocator<U>; };
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const { return pool_ == other.pool_; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const { return pool_ != other.pool_; }
+
+private:
+    template <typename U> friend class PoolAllocator;
+    std::shared_ptr<TcpConnectionPool> pool_;
+};
@@ -0,0 +1,48 @@
+#include "TcpInfo.h"
+#include "Timestamp.h"
+
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/sockios.h>
+
+TcpInfo::TcpInfo()
+{
+    ::memset(this, 0, sizeof *this);
+}
+
+bool TcpInfo::sample(int fd, TcpInfo *info)
+{
+    struct tcp_info ti;
+    ::memset(&ti, 0, sizeof ti);
+    socklen_t len = sizeof ti;
+    if(::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0)
+    {
+        return false;
+    }
+    info->sampleTime = Timestamp::now().microSecondsSinceEpoch();
+    info->state = ti.tcpi_state;
+    info->caState = ti.tcpi_ca_state;
+    info->rttMicros = ti.tcpi_rtt;
+    info->rttVarMicros = ti.tcpi_rttvar;
+    info->rtoMicros = ti.tcpi_rto;
+    info->sndMss = ti.tcpi_snd_mss;
+    info->sndCwnd = ti.tcpi_snd_cwnd;
+    info->sndSsthresh = ti.tcpi_snd_ssthresh;
+    info->unacked = ti.tcpi_unacked;
+    info->lost = ti.tcpi_lost;
+    info->totalRetrans = ti.tcpi_total_retrans;
+    info->lastDataRecvMs = ti.tcpi_last_data_recv;
+
+    // SIOCOUTQ是发送队列中的全部字节（未确认+未发出），SIOCOUTQNSD只含未发出的
+    int queued = 0;
+    int notSent = 0;
+    if(::ioctl(fd, SIOCOUTQ, &queued) == 0 && ::ioctl(fd, SIOCOUTQNSD, &notSent) == 0 && queued >= notSent)
+    {
+        info->inFlightBytes = static_cast<size_t>(queued - notSent);
+        info->notSentBytes = static_cast<size_t>(notSent);
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 一个TCP连接在内核中的状态快照，来自getsockopt(TCP_INFO)和SIOCOUTQ/SIOCOUTQNSD
+// 用来区分慢是网络（RTT高、重传、拥塞窗口小、在途数据多）还是服务器自己（outputBuffer_积压）
+struct TcpInfo
+{
+    TcpInfo();
+
+    // 读取fd的TCP_INFO，失败（如Unix域socket）返回false
+    static bool sample(int fd, TcpInfo *info);
+
+    int64_t sampleTime;       // 采样时间，CLOCK_REALTIME微秒
+    uint8_t state;            // TCP_ESTABLISHED等
+    uint8_t caState;          // 拥塞控制状态 TCP_CA_Open/Disorder/CWR/Recovery/Loss
+    uint32_t rttMicros;       // 平滑RTT
+    uint32_t rttVarMicros;
+    uint32_t rtoMicros;
+    uint32_t sndMss;
+    uint32_t sndCwnd;         // 拥塞窗口，单位为段
+    uint32_t sndSsthresh;
+    uint32_t unacked;         // 已发出未确认的段数
+    uint32_t lost;            // 内核认为丢失的段数
+    uint32_t totalRetrans;    // 连接建立以来重传的段数
+    uint32_t lastDataRecvMs;  // 距最后一次收到数据的毫秒数
+    size_t inFlightBytes;     // 已发出未确认的字节数
+    size_t notSentBytes;      // 内核发送队列中还没发出的字节数
+    size_t outputBufferBytes; // 用户态outputBuffer_中的积压，由TcpConnection填写
+};
@@ -1,9 +1,15 @@
 #include "TcpServer.h"
 #include "Logger.h"
+#include "Socket.h"
 #include "TcpConnection.h"
+#include "TcpConnectionPool.h"
+#include "ListenFdHandover.h"
+#include "CpuPlacement.h"
 
 #include <strings.h>
+#include <algorithm>
 #include <functional>
+#include <future>
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -14,6 +20,9 @@ static EventLoop* CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
+// TCP_INFO采样时每采一个连接最多访问的桶数，限制连接高峰过后空桶的遍历开销
+static const size_t kTcpInfoBucketsPerSample = 4;
+
 TcpServer::TcpServer(EventLoop *loop,
                 const  InetAddress &listenAddr,
                 const std::string &nameArg,
@@ -25,27 +34,86 @@ TcpServer::TcpServer(EventLoop *loop,
                 , threadPool_(new EventLoopThreadPool(loop, name_))
                 , connectionCallback_()
                 , messageCallback_()
-                , nextConnId_(1)
                 , started_(0) // 注意要初始化
+                , draining_(false)
+                , drained_(false)
+                , numConnections_(0)
+                , nextConnId_(1)
+                , maxLoopLagMicros_(0)
+                , latencyTracking_(false)
+                , incomingCpuRouting_(false)
+                , tcpInfoInterval_(0.0)
+                , tcpInfoBatchSize_(0)
+                , metricsId_(0)
 {
     // 当有新用户连接时，会执行 TcpServer::newConnection
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
         std::placeholders::_1, std::placeholders::_2));
 }
 
+TcpServer::TcpServer(EventLoop *loop,
+                int listenfd,
+                const std::string &nameArg)
+                :loop_(CheckLoopNotNull(loop))
+                , ipPort_(Socket::getLocalAddr(listenfd).toIpPort())
+                , name_(nameArg)
+                , acceptor_(new Acceptor(loop, listenfd))
+                , threadPool_(new EventLoopThreadPool(loop, name_))
+                , started_(0)
+                , draining_(false)
+                , drained_(false)
+                , numConnections_(0)
+                , nextConnId_(1)
+                , maxLoopLagMicros_(0)
+                , latencyTracking_(false)
+                , incomingCpuRouting_(false)
+                , tcpInfoInterval_(0.0)
+                , tcpInfoBatchSize_(0)
+                , metricsId_(0)
+{
+    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
+        std::placeholders::_1, std::placeholders::_2));
+}
+
 TcpServer::~TcpServer()
 {
-    for(auto &item : connections_)
+    if(metricsId_ != 0)
+    {
+        MetricsRegistry::instance().remove(metricsId_);
+    }
+    for(auto &item : shards_)
+    {
+        ConnectionShard *shard = item.second.get();
+        if(shard->loop->isInLoopThread())
+        {
+            destroyShard(shard);
+        }
+        else
+        {
+            // 分片只能在其subLoop线程中访问，等待销毁完成后才能释放分片
+            std::promise<void> done;
+            shard->loop->runInLoop([shard, &done]() {
+                destroyShard(shard);
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+}
+
+void TcpServer::destroyShard(ConnectionShard *shard)
+{
+    shard->loop->cancel(shard->tcpInfoTimer);
+    for(auto &item : shard->connections)
     {
         // 这个局部的shared_ptr智能指针对象，出右括号，可自动释放new出来的TcpConnection对象资源
         TcpConnectionPtr conn(item.second); // 下一行reset释放后用不了item.second
         item.second.reset();
 
         // 销毁链接
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn)
-        );
+        conn->connectDestroyed();
     }
+    shard->connections.clear();
 }
 
 void TcpServer::setThreadNum(int numThreads)
@@ -61,73 +129,386 @@ void TcpServer::start()
     {
         // 启动subLoop
         threadPool_->start(threadInitCallback_); // 启动底层的线程池
+        // 每个subLoop一个连接分片，没有subLoop时只有baseLoop一个分片
+        ioLoops_ = threadPool_->getAllLoops();
+        for(EventLoop *ioLoop : ioLoops_)
+        {
+            ConnectionShard *shard = new ConnectionShard(ioLoop);
+            shards_[ioLoop].reset(shard);
+
+            // 下面回调都是用户设置给TcpServer -> TcpConnection ->Channel ->Poller -> notify Channel执行回调
+            // 同一分片的连接共享一张回调表，关闭回调直接在subLoop中把连接从分片移除
+            std::shared_ptr<TcpConnectionCallbacks> callbacks = std::make_shared<TcpConnectionCallbacks>();
+            callbacks->namePrefix = name_ + "-" + ipPort_;
+            callbacks->connectionCallback = connectionCallback_;
+            callbacks->messageCallback = messageCallback_;
+            callbacks->writeCompleteCallback = writeCompleteCallback_;
+            callbacks->closeCallback = std::bind(&TcpServer::removeConnection, this, shard, std::placeholders::_1);
+            callbacks->socketOptions = socketOptions_;
+            callbacks->metrics = &shard->metrics;
+            callbacks->trackLatency = latencyTracking_;
+            // 服务器总带宽按subLoop平均切分，每个分片的令牌桶只在自己的loop线程中使用，无需加锁
+            double numShards = static_cast<double>(ioLoops_.size());
+            if(serverReadLimit_.rate > 0.0)
+            {
+                shard->readLimit.reset(serverReadLimit_.rate / numShards, serverReadLimit_.burst / numShards);
+                callbacks->sharedReadLimit = &shard->readLimit;
+            }
+            if(serverWriteLimit_.rate > 0.0)
+            {
+                shard->writeLimit.reset(serverWriteLimit_.rate / numShards, serverWriteLimit_.burst / numShards);
+                callbacks->sharedWriteLimit = &shard->writeLimit;
+            }
+            shard->callbacks = callbacks;
+            if(tcpInfoInterval_ > 0.0)
+            {
+                shard->tcpInfoTimer = ioLoop->runEvery(tcpInfoInterval_, std::bind(&TcpServer::sampleTcpInfo, this, shard));
+            }
+        }
+        metricsId_ = MetricsRegistry::instance().add(std::bind(&TcpServer::collectMetrics, this, std::placeholders::_1));
+        acceptor_->setSocketOptions(socketOptions_);
         // 执行 Acceptor::listen
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
 
+TcpServer::ConnectionShard* TcpServer::shardOf(EventLoop *ioLoop) const
+{
+    auto it = shards_.find(ioLoop);
+    return it != shards_.end() ? it->second.get() : nullptr;
+}
+
 // 有一个新客户端连接，Acceptor会执行这个回调
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
-    // round-robin,选一个subLoop管理channel
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+    EventLoop *ioLoop = nullptr;
+    if(incomingCpuRouting_)
+    {
+        // 交给处理该连接收包软中断的CPU上的loop，收包、协议栈和回调都在同一个核上，缓存是热的
+        ioLoop = threadPool_->getLoopForCpu(CpuPlacement::incomingCpu(sockfd));
+        if(ioLoop != nullptr)
+        {
+            incomingCpuRouted_.increment();
+        }
+        else
+        {
+            incomingCpuFallback_.increment();
+        }
+    }
+    if(ioLoop == nullptr)
+    {
+        // round-robin,选一个subLoop管理channel
+        ioLoop = threadPool_->getNextLoop();
+    }
+    uint64_t connId = nextConnId_++;
+    // 在baseLoop中先计数，连接还没在subLoop中建好时drain也能看到它，关闭时在removeConnection中减掉
+    ++numConnections_;
 
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-        name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+    // TcpConnection在subLoop中创建，使用该loop线程的对象池
+    ioLoop->runInLoop(std::bind(&TcpServer::newConnectionInLoop, this,
+        shardOf(ioLoop), sockfd, connId, peerAddr));
+}
 
+void TcpServer::newConnectionInLoop(ConnectionShard *shard, int sockfd, uint64_t connId, const InetAddress &peerAddr)
+{
     // 通过sockfd获取其绑定的本机的ip地址和端口消息
-    sockaddr_in local;
-    ::bzero(&local, sizeof local);
-    socklen_t addrlen = sizeof local;
-    if(::getsockname(sockfd, (sockaddr*)&local, &addrlen) < 0)
-    {
-        LOG_ERROR("sockets::getLocalAddr");
-    }
-    InetAddress localAddr(local);
+    InetAddress localAddr(Socket::getLocalAddr(sockfd));
 
     // 根据连接成功的sockfd，创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(
-                            ioLoop,
-                            connName,
+    TcpConnectionPtr conn(TcpConnectionPool::forCurrentThread()->create(
+                            shard->loop,
+                            connId,
+                            shard->callbacks,
                             sockfd,
                             localAddr,
                             peerAddr));
-    connections_[connName] = conn;
 
-    // 下面回调都是用户设置给TcpServer -> TcpConnection ->Channel ->Poller -> notify Channel执行回调
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
+        name_.c_str(), conn->name().c_str(), peerAddr.toIpPort().c_str());
+
+    shard->connections[connId] = conn;
+    shard->metrics.accepted.increment();
+    if(connReadLimit_.rate > 0.0)
+    {
+        conn->setReadRateLimit(connReadLimit_.rate, connReadLimit_.burst);
+    }
+    if(connWriteLimit_.rate > 0.0)
+    {
+        conn->setWriteRateLimit(connWriteLimit_.rate, connWriteLimit_.burst);
+    }
+    conn->connectEstablished();
+}
+
+// 由TcpConnection::handleClose在其subLoop中调用
+void TcpServer::removeConnection(ConnectionShard *shard, const TcpConnectionPtr &conn)
+{
+    LOG_INFO("TcpServer::removeConnection [%s] - connection %s\n",
+        name_.c_str(), conn->name().c_str());
 
-    // 设置如何关闭连接的回调 conn->handleClose()
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)
+    shard->connections.erase(conn->id());
+    shard->metrics.closed.increment();
+    // 当前还处于Channel::handleEvent中，connectDestroyed放到本轮回调之后执行
+    shard->loop->queueInLoop(
+        std::bind(&TcpConnection::connectDestroyed, conn)
     );
 
-    // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    if(--numConnections_ == 0 && draining_)
+    {
+        loop_->runInLoop(std::bind(&TcpServer::finishDrain, this));
+    }
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::enableTcpInfoSampling(double interval, size_t batchSize)
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn)
-    );
+    tcpInfoInterval_ = interval;
+    tcpInfoBatchSize_ = batchSize > 0 ? batchSize : 1;
 }
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+
+void TcpServer::sampleTcpInfo(ConnectionShard *shard)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-        name_.c_str(), conn->name().c_str());
+    ConnectionMap &connections = shard->connections;
+    if(connections.empty())
+    {
+        return;
+    }
+    // 按桶轮转而不是按连接轮转，不需要额外的数据结构；期间发生rehash时个别连接会被跳过或重复采样，对采样无妨
+    // unordered_map的桶数组不会随连接减少而收缩，连接高峰过后大部分桶是空的，
+    // 所以除了采样个数，每次访问的桶数也有上限；同一个桶采到一半时记下位置，下次接着采
+    ConnectionMetrics &m = shard->metrics;
+    const size_t numBuckets = connections.bucket_count();
+    const size_t maxVisits = std::min(numBuckets, tcpInfoBatchSize_ * kTcpInfoBucketsPerSample);
+    size_t sampled = 0;
+    for(size_t visited = 0; visited < maxVisits && sampled < tcpInfoBatchSize_; ++visited)
+    {
+        size_t bucket = shard->tcpInfoCursor % numBuckets;
+        size_t skip = shard->tcpInfoOffset;
+        auto it = connections.begin(bucket);
+        for(; it != connections.end(bucket) && sampled < tcpInfoBatchSize_; ++it)
+        {
+            if(skip > 0)
+            {
+                --skip;
+                continue;
+            }
+            ++shard->tcpInfoOffset;
+            ++sampled;
+            TcpInfo info;
+            if(!it->second->tcpInfo(&info))
+            {
+                continue;
+            }
+            m.tcpInfoSamples.increment();
+            m.rttMicros.observe(info.rttMicros);
+            m.cwndSegments.observe(info.sndCwnd);
+            m.unackedSegments.observe(info.unacked);
+            m.totalRetrans.observe(info.totalRetrans);
+            m.inFlightBytes.observe(info.inFlightBytes);
+            m.notSentBytes.observe(info.notSentBytes);
+            m.outputBufferBytes.observe(info.outputBufferBytes);
+        }
+        if(it == connections.end(bucket))
+        {
+            ++shard->tcpInfoCursor;
+            shard->tcpInfoOffset = 0;
+        }
+    }
+}
 
-    connections_.erase(conn->name());
-    // 获得conn所属的Loop
-    EventLoop *ioLoop = conn->getLoop();
-    // 在ioLoop对应的线程执行 TcpConnection::connectDestroyed(conn)
-    ioLoop->queueInLoop(
-        std::bind(&TcpConnection::connectDestroyed, conn)
-    );
+// 在抓取指标的线程中调用，分片的计数器只读不写，不需要切到subLoop
+void TcpServer::collectMetrics(MetricsWriter &writer)
+{
+    uint64_t accepted = 0, closed = 0, bytesRead = 0, bytesWritten = 0, bytesQueued = 0, highWaterMarkHits = 0;
+    for(auto &item : shards_)
+    {
+        const ConnectionMetrics &m = item.second->metrics;
+        accepted += m.accepted.value();
+        closed += m.closed.value();
+        bytesRead += m.bytesRead.value();
+        bytesWritten += m.bytesWritten.value();
+        bytesQueued += m.bytesQueued.value();
+        highWaterMarkHits += m.highWaterMarkHits.value();
+    }
+
+    std::string labels = "server=\"" + MetricsWriter::escapeLabel(name_) + "\"";
+    writer.counter("mymuduo_server_connections_accepted_total", "Connections established.", labels, accepted);
+    writer.counter("mymuduo_server_connections_closed_total", "Connections closed.", labels, closed);
+    writer.gauge("mymuduo_server_connections", "Connections currently open.", labels, static_cast<int64_t>(numConnections_.load()));
+    writer.counter("mymuduo_server_accept_rejected_total", "Connections closed right after accept because of maxConnections.", labels, numRejected());
+    writer.counter("mymuduo_server_accept_deferred_total", "Times accept was postponed by rate limit or overload.", labels, numDeferred());
+    writer.counter("mymuduo_server_read_bytes_total", "Bytes read from connections.", labels, bytesRead);
+    writer.counter("mymuduo_server_written_bytes_total", "Bytes written to connections.", labels, bytesWritten);
+    writer.counter("mymuduo_server_output_queued_bytes_total", "Bytes queued in outputBuffer because the socket was not writable.", labels, bytesQueued);
+    writer.counter("mymuduo_server_high_water_mark_total", "Times an outputBuffer crossed its high water mark.", labels, highWaterMarkHits);
+
+    if(incomingCpuRouting_)
+    {
+        writer.counter("mymuduo_server_incoming_cpu_routed_total", "Connections assigned to the loop on their SO_INCOMING_CPU.", labels, incomingCpuRouted_.value());
+        writer.counter("mymuduo_server_incoming_cpu_fallback_total", "Connections assigned round-robin because no loop runs on their SO_INCOMING_CPU.", labels, incomingCpuFallback_.value());
+    }
+
+    if(tcpInfoInterval_ > 0.0)
+    {
+        uint64_t samples = 0;
+        MetricsWriter::HistogramSnapshot rtt, cwnd, unacked, retrans, inFlight, notSent, backlog;
+        for(auto &item : shards_)
+        {
+            const ConnectionMetrics &m = item.second->metrics;
+            samples += m.tcpInfoSamples.value();
+            rtt.add(m.rttMicros);
+            cwnd.add(m.cwndSegments);
+            unacked.add(m.unackedSegments);
+            retrans.add(m.totalRetrans);
+            inFlight.add(m.inFlightBytes);
+            notSent.add(m.notSentBytes);
+            backlog.add(m.outputBufferBytes);
+        }
+        writer.counter("mymuduo_server_tcpinfo_samples_total", "TCP_INFO samples taken.", labels, samples);
+        writer.histogram("mymuduo_server_tcpinfo_rtt_microseconds", "Smoothed RTT of sampled connections.", labels, rtt);
+        writer.histogram("mymuduo_server_tcpinfo_cwnd_segments", "Congestion window of sampled connections.", labels, cwnd);
+        writer.histogram("mymuduo_server_tcpinfo_unacked_segments", "Unacknowledged segments of sampled connections.", labels, unacked);
+        writer.histogram("mymuduo_server_tcpinfo_retransmits", "Total retransmitted segments of sampled connections.", labels, retrans);
+        writer.histogram("mymuduo_server_tcpinfo_in_flight_bytes", "Bytes sent but not acknowledged.", labels, inFlight);
+        writer.histogram("mymuduo_server_tcpinfo_not_sent_bytes", "Bytes in the kernel send queue not sent yet.", labels, notSent);
+        writer.histogram("mymuduo_server_tcpinfo_output_buffer_bytes", "Bytes waiting in outputBuffer.", labels, backlog);
+    }
+
+    if(latencyTracking_)
+    {
+        for(int phase = 0; phase < ConnectionLatency::kNumPhases; ++phase)
+        {
+            MetricsWriter::HistogramSnapshot latency;
+            for(auto &item : shards_)
+            {
+                latency.add(item.second->metrics.latency[phase]);
+            }
+            writer.histogram("mymuduo_server_latency_microseconds", "Time spent in each phase of a request.",
+                labels + ",phase=\"" + ConnectionLatency::phaseName(phase) + "\"", latency);
+        }
+    }
+}
+
+void TcpServer::setAcceptRateLimit(double rate, double burst)
+{
+    acceptor_->setRateLimit(rate, burst);
+}
+
+void TcpServer::setMaxConnections(size_t maxConnections)
+{
+    acceptor_->setMaxConnections(maxConnections, std::bind(&TcpServer::numConnections, this));
+}
+
+void TcpServer::setMaxLoopLag(double maxLag)
+{
+    maxLoopLagMicros_ = static_cast<int64_t>(maxLag * 1000 * 1000);
+    // 过载时每隔maxLag检查一次是否恢复
+    acceptor_->setOverloadCallback(std::bind(&TcpServer::loopsOverloaded, this), maxLag);
+}
+
+void TcpServer::setConnectionReadRateLimit(double bytesPerSecond, double burst)
+{
+    connReadLimit_.rate = bytesPerSecond;
+    connReadLimit_.burst = burst;
+}
+
+void TcpServer::setConnectionWriteRateLimit(double bytesPerSecond, double burst)
+{
+    connWriteLimit_.rate = bytesPerSecond;
+    connWriteLimit_.burst = burst;
+}
+
+void TcpServer::setServerReadRateLimit(double bytesPerSecond, double burst)
+{
+    serverReadLimit_.rate = bytesPerSecond;
+    serverReadLimit_.burst = burst;
+}
+
+void TcpServer::setServerWriteRateLimit(double bytesPerSecond, double burst)
+{
+    serverWriteLimit_.rate = bytesPerSecond;
+    serverWriteLimit_.burst = burst;
+}
+
+bool TcpServer::loopsOverloaded() const
+{
+    for(EventLoop *ioLoop : ioLoops_)
+    {
+        // 只有baseLoop一个loop时，它正在执行本函数，不算过载
+        if(!ioLoop->isInLoopThread() && ioLoop->lagMicros() > maxLoopLagMicros_)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TcpServer::enableHandover(const std::string &path, double drainTimeout)
+{
+    std::vector<int> fds(1, acceptor_->listenFd());
+    handover_.reset(new ListenFdHandover(loop_, path, fds));
+    if(!handover_->listening())
+    {
+        handover_.reset();
+        return false;
+    }
+    // 新进程已经拿到监听socket，本进程停止accept并排空连接
+    handover_->setHandoverCallback(std::bind(&TcpServer::drain, this, drainTimeout));
+    return true;
+}
+
+void TcpServer::drain(double timeout)
+{
+    loop_->runInLoop(std::bind(&TcpServer::drainInLoop, this, timeout));
+}
+
+void TcpServer::drainInLoop(double timeout)
+{
+    if(draining_)
+    {
+        return;
+    }
+    draining_ = true;
+    acceptor_->stopListening();
+    LOG_INFO("TcpServer::drain [%s] - %lu connections left, timeout %.1fs\n",
+        name_.c_str(), static_cast<size_t>(numConnections_), timeout);
+
+    if(numConnections_ == 0)
+    {
+        finishDrain();
+    }
+    else
+    {
+        drainTimer_ = loop_->runAfter(timeout, std::bind(&TcpServer::forceCloseAll, this));
+    }
+}
+
+void TcpServer::forceCloseAll()
+{
+    LOG_INFO("TcpServer::forceCloseAll [%s] - %lu connections\n",
+        name_.c_str(), static_cast<size_t>(numConnections_));
+    for(auto &item : shards_)
+    {
+        ConnectionShard *shard = item.second.get();
+        shard->loop->runInLoop([shard]() {
+            for(auto &conn : shard->connections)
+            {
+                conn.second->forceClose();
+            }
+        });
+    }
+}
+
+// 在baseLoop中执行，可能被最后一个连接关闭和排空超时两条路径触发
+void TcpServer::finishDrain()
+{
+    if(!draining_ || drained_ || numConnections_ != 0)
+    {
+        return;
+    }
+    drained_ = true;
+    loop_->cancel(drainTimer_);
+    LOG_INFO("TcpServer::drain [%s] - all connections closed\n", name_.c_str());
+    if(drainCompleteCallback_)
+    {
+        drainCompleteCallback_();
+    }
 }
@@ -8,19 +8,26 @@
 #include "EventLoopThreadPool.h"
 #include "TcpConnection.h"
 #include "Callbacks.h"
+#include "TimerId.h"
+#include "TokenBucket.h"
+#include "Metrics.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 // 对外的服务器编程使用的类
 // 再这个类对象里设置连接的事件回调操作
+class ListenFdHandover;
+
 class TcpServer
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    using DrainCompleteCallback = std::function<void()>;
 
     enum Option
     {
@@ -32,27 +39,131 @@ public:
                 const  InetAddress &listenAddr,
                 const std::string &nameArg,
                 Option option = kNoReusePort);
+    // 接管一个已经在监听的socket，通常来自ListenFdHandover::receive()
+    TcpServer(EventLoop *loop,
+                int listenfd,
+                const std::string &nameArg);
 
     ~TcpServer();
 
     void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    // 下面的回调须在start()之前设置，start()时生成所有连接共享的回调表
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
 
 
+    // 监听socket和每个连接socket的选项，须在start()之前设置
+    // 例如 server.setSocketOptions(SocketOptions::lowLatencyRpc());
+    void setSocketOptions(const SocketOptions &opts) { socketOptions_ = opts; }
+
+    // 记录每个请求从epoll_wait返回到数据发完的各阶段耗时，汇总为本服务器的直方图，
+    // 单个连接的统计用TcpConnection::latency()查看；关闭时（默认）没有额外开销，须在start()之前设置
+    void enableLatencyTracking(bool on) { latencyTracking_ = on; }
+
+    // 定期在各subLoop中对连接采样TCP_INFO，汇总为本服务器的RTT、拥塞窗口、在途字节、积压等分布
+    // 每隔interval秒每个subLoop最多采样batchSize个连接，按连接表轮转，连接数为N时每个连接约每 N/batchSize*interval 秒采样一次
+    // 单个连接的getsockopt约1~2us，batchSize限制了每次占用loop的时间；须在start()之前设置
+    void enableTcpInfoSampling(double interval, size_t batchSize = 256);
+
     // 设置底层subloop个数
     void setThreadNum(int numThreads);
 
+    // subLoop的CPU绑定，见EventLoopThreadPool::setCpuAffinity/setAutoCpuAffinity，须在start()之前设置
+    // 绑定后连接对象和收发缓冲区都在loop线程中分配，落在该CPU的NUMA节点上
+    void setCpuAffinity(const std::vector<int> &cpus) { threadPool_->setCpuAffinity(cpus); }
+    void setAutoCpuAffinity(const std::vector<int> &reserved = std::vector<int>()) { threadPool_->setAutoCpuAffinity(reserved); }
+    // 按SO_INCOMING_CPU把新连接交给绑定在收包CPU上的subLoop，该CPU上没有loop时仍按轮询分配
+    // 需要同时把网卡队列的中断（RSS/RPS）绑到loop所在的CPU上，否则只会退化为轮询；须在start()之前设置
+    void enableIncomingCpuRouting(bool on) { incomingCpuRouting_ = on; }
+
     // 开启服务器监听
     void start();
 
+    // 平滑重启：新进程连接path时，把监听socket交给它，
+    // 然后本进程停止accept并排空现有连接，最多等待drainTimeout秒
+    // 无法在path上监听时返回false
+    bool enableHandover(const std::string &path, double drainTimeout);
+    // 停止accept新连接，等待现有连接关闭，超过timeout秒后强制关闭剩余连接
+    // 可在任意线程调用
+    void drain(double timeout);
+    // 所有连接都已关闭时在baseLoop中调用，一般用来退出loop
+    void setDrainCompleteCallback(const DrainCompleteCallback &cb) { drainCompleteCallback_ = cb; }
+    bool draining() const { return draining_; }
+
+    // 当前连接数，含已accept、尚未在subLoop中建立的连接，可在任意线程调用
+    size_t numConnections() const { return numConnections_; }
+
+    // 准入控制，须在start()之前设置
+    // 每秒最多接受rate个新连接，允许burst个突发，超出的留在内核backlog中稍后accept
+    void setAcceptRateLimit(double rate, double burst);
+    // 连接数达到上限后，新连接accept后立即关闭
+    void setMaxConnections(size_t maxConnections);
+    // 任一subLoop单轮处理超过maxLag秒时暂停accept，直到subLoop缓过来
+    void setMaxLoopLag(double maxLag);
+
+    // 带宽整形，单位字节/秒，burst为0时等于rate，rate <= 0表示不限速，须在start()之前设置
+    // 每个连接各自的收发速率上限
+    void setConnectionReadRateLimit(double bytesPerSecond, double burst = 0.0);
+    void setConnectionWriteRateLimit(double bytesPerSecond, double burst = 0.0);
+    // 整个服务器所有连接合计的收发速率上限，平均分到每个subLoop
+    void setServerReadRateLimit(double bytesPerSecond, double burst = 0.0);
+    void setServerWriteRateLimit(double bytesPerSecond, double burst = 0.0);
+
+    // 准入计数：已接受 / 因连接数满被拒绝 / 因限速或过载推迟accept的次数
+    uint64_t numAccepted() const { return acceptor_->numAccepted(); }
+    uint64_t numRejected() const { return acceptor_->numRejected(); }
+    uint64_t numDeferred() const { return acceptor_->numDeferred(); }
+    // 上面的计数和各分片的连接指标在start()时登记到MetricsRegistry，标签为 server="name"
+
 private:
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
+
+    // 连接表按subLoop分片，每个分片只在其所属loop线程中访问，无需加锁
+    // 连接的建立和销毁都在自己的subLoop中完成，不再经过mainLoop
+    struct ConnectionShard
+    {
+        explicit ConnectionShard(EventLoop *ioLoop) : loop(ioLoop) {}
+
+        EventLoop *loop;
+        ConnectionMap connections;
+        TcpConnectionCallbacksPtr callbacks; // 本分片所有连接共享的回调表
+        // 服务器总带宽在本分片的份额，本分片所有连接共用
+        TokenBucket readLimit;
+        TokenBucket writeLimit;
+        ConnectionMetrics metrics; // 本分片连接的指标，抓取时各分片相加
+        TimerId tcpInfoTimer;
+        size_t tcpInfoCursor = 0; // 下一次从连接表的哪个桶开始采样
+        size_t tcpInfoOffset = 0; // 该桶中已采样的连接数
+    };
+
+    struct RateLimit
+    {
+        RateLimit() : rate(0.0), burst(0.0) {}
+        double rate;
+        double burst;
+    };
+
     void newConnection(int sockfd, const InetAddress &peerAddr);
-    void removeConnection(const TcpConnectionPtr &conn); // 在map中移除TcpConnection
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
-    
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    // 在subLoop中从本线程的对象池创建连接，登记到分片并建立连接
+    void newConnectionInLoop(ConnectionShard *shard, int sockfd, uint64_t connId, const InetAddress &peerAddr);
+    // 在subLoop中把TcpConnection从分片中移除
+    void removeConnection(ConnectionShard *shard, const TcpConnectionPtr &conn);
+    // 在分片所属loop中销毁其全部连接，仅析构时使用
+    static void destroyShard(ConnectionShard *shard);
+    void collectMetrics(MetricsWriter &writer);
+    // 在分片的loop中采样一批连接的TCP_INFO
+    void sampleTcpInfo(ConnectionShard *shard);
+
+    ConnectionShard* shardOf(EventLoop *ioLoop) const;
+
+    // subLoop是否处理不过来，Acceptor据此暂停accept
+    bool loopsOverloaded() const;
+
+    void drainInLoop(double timeout);
+    // 排空超时，在各自的subLoop中强制关闭剩余的连接
+    void forceCloseAll();
+    void finishDrain();
 
     EventLoop *loop_;   // baseLoop
     const std::string ipPort_;
@@ -68,6 +179,30 @@ private:
 
     std::atomic_int started_;
 
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有连接
+    std::unique_ptr<ListenFdHandover> handover_;
+    std::atomic_bool draining_;
+    bool drained_; // 只在baseLoop中访问
+    std::atomic<size_t> numConnections_; // accept时在baseLoop中加，removeConnection中减
+    TimerId drainTimer_;
+    DrainCompleteCallback drainCompleteCallback_;
+
+    uint64_t nextConnId_; // 只在mainLoop中递增
+    // 保存所有连接，key为subLoop; start()之后只读，可跨线程查找
+    std::unordered_map<EventLoop*, std::unique_ptr<ConnectionShard>> shards_;
+    std::vector<EventLoop*> ioLoops_; // start()之后只读
+    int64_t maxLoopLagMicros_;
+
+    bool latencyTracking_;
+    bool incomingCpuRouting_;
+    // 按收包CPU分配成功 / 退回轮询的连接数，只在mainLoop中更新
+    MetricsCounter incomingCpuRouted_;
+    MetricsCounter incomingCpuFallback_;
+    double tcpInfoInterval_; // 0表示不采样
+    size_t tcpInfoBatchSize_;
+    uint64_t metricsId_; // 登记到MetricsRegistry的id，0表示未登记
+    SocketOptions socketOptions_; // start()之后只读
+    RateLimit connReadLimit_;
+    RateLimit connWriteLimit_;
+    RateLimit serverReadLimit_;
+    RateLimit serverWriteLimit_;
 };
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "Timer.h"
+#include "Timestamp.h"
+
+std::atomic<int64_t> Timer::s_numCreated_(0);
+const int64_t Timer::kMicroSecondsPerSecond;
+
+void Timer::restart(int64_t now)
+{
+    if(repeat_)
+    {
+        expiration_ = now + static_cast<int64_t>(interval_ * kMicroSecondsPerSecond);
+    }
+    else
+    {
+        expiration_ = 0;
+    }
+}
+
+int64_t Timer::now()
+{
+    return Timestamp::monotonicNow().microSecondsSinceEpoch();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+#include <atomic>
+#include <stdint.h>
+
+// 定时器：到期时间和回调，可选周期执行
+// 时间统一使用单调时钟的微秒数，不受系统时间调整的影响
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, int64_t when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++s_numCreated_)
+    {}
+
+    void run() const { callback_(); }
+
+    int64_t expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 周期定时器重新计算下一次到期时间
+    void restart(int64_t now);
+
+    // 单调时钟的当前时间，微秒
+    static int64_t now();
+
+    static const int64_t kMicroSecondsPerSecond = 1000 * 1000;
+
+private:
+    const TimerCallback callback_;
+    int64_t expiration_;
+    const double interval_; // 秒
+    const bool repeat_;
+    const int64_t sequence_; // 区分地址相同的新旧定时器
+
+    static std::atomic<int64_t> s_numCreated_;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+// 定时器的标识，用于EventLoop::cancel，可拷贝
+class TimerId
+{
+public:
+    TimerId()
+        : timer_(nullptr)
+        , sequence_(0)
+    {}
+
+    TimerId(Timer *timer, int64_t seq)
+        : timer_(timer)
+        , sequence_(seq)
+    {}
+
+    friend class TimerQueue;
+
+private:
+    Timer *timer_;
+    int64_t sequence_;
+};
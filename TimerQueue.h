@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+class EventLoop;
+class Timer;
+
+// 定时器队列：所有定时器共用一个timerfd，注册到所属EventLoop上
+// timerfd总是设置为最早到期的定时器的时间
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全，可在其他线程调用
+    TimerId addTimer(TimerCallback cb, int64_t when, double interval);
+    void cancel(TimerId timerId);
+
+private:
+    // key: 到期时间，Timer*区分同一时间到期的定时器
+    using Entry = std::pair<int64_t, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，执行所有到期的定时器
+    void handleRead();
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(int64_t now);
+    void reset(const std::vector<Entry> &expired, int64_t now);
+    // 返回新定时器是否成为了最早到期的那个
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_; // 按到期时间排序
+
+    // 和timers_保存相同的定时器，按地址排序，供cancel查找
+    ActiveTimerSet activeTimers_;
+    bool callingExpiredTimers_;
+    // 执行到期回调期间被取消的周期定时器，不再重新加入
+    ActiveTimerSet cancelingTimers_;
+};
@@ -1,7 +1,22 @@
 #include "Timestamp.h"
-#include <time.h>
 
+#include <stdio.h>
+#include <string.h>
 
+const int64_t Timestamp::kMicroSecondsPerSecond;
+const size_t Timestamp::kFormattedSize;
+
+// 每个线程缓存最近一次格式化的秒和对应的"年/月/日 时:分:秒"
+static __thread time_t t_lastSecond = -1;
+static __thread char t_secondPrefix[24];
+static __thread size_t t_secondPrefixLen = 0;
+
+static int64_t clockMicros(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
 
 Timestamp::Timestamp():microSecondsSinceEpoch_(0) {};
 
@@ -11,27 +26,72 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     {}
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    return Timestamp(clockMicros(CLOCK_REALTIME));
+}
+
+Timestamp Timestamp::monotonicNow()
+{
+    return Timestamp(clockMicros(CLOCK_MONOTONIC));
 }
+
 // 将时间转换为年月日时分秒的格式
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);   
+    time_t seconds = secondsSinceEpoch();
+    tm tm_time;
+    localtime_r(&seconds, &tm_time);
     snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-        tm_time->tm_year + 1900,
-        tm_time->tm_mon + 1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
+        tm_time.tm_year + 1900,
+        tm_time.tm_mon + 1,
+        tm_time.tm_mday,
+        tm_time.tm_hour,
+        tm_time.tm_min,
+        tm_time.tm_sec);
 
     return buf;
 }
 
-// #include <iostream>
-// int main()
-// {
-//     std::cout << Timestamp::now().toString() << std::endl;
-//     return 0;
-// }
\ No newline at end of file
+std::string Timestamp::toFormattedString() const
+{
+    char buf[kFormattedSize];
+    size_t len = formatTo(buf, sizeof buf);
+    return std::string(buf, len);
+}
+
+size_t Timestamp::formatTo(char *buf, size_t size) const
+{
+    if(size < kFormattedSize)
+    {
+        return 0;
+    }
+    time_t seconds = secondsSinceEpoch();
+    int micros = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+    if(seconds != t_lastSecond)
+    {
+        // 换了一秒才做时区转换
+        tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        int n = snprintf(t_secondPrefix, sizeof t_secondPrefix, "%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year + 1900,
+            tm_time.tm_mon + 1,
+            tm_time.tm_mday,
+            tm_time.tm_hour,
+            tm_time.tm_min,
+            tm_time.tm_sec);
+        t_secondPrefixLen = static_cast<size_t>(n);
+        t_lastSecond = seconds;
+    }
+    memcpy(buf, t_secondPrefix, t_secondPrefixLen);
+    // 手写6位微秒，比snprintf快
+    char *p = buf + t_secondPrefixLen;
+    *p++ = '.';
+    for(int i = 5; i >= 0; --i)
+    {
+        p[i] = static_cast<char>('0' + micros % 10);
+        micros /= 10;
+    }
+    p += 6;
+    *p = '\0';
+    return static_cast<size_t>(p - buf);
+}
@@ -2,16 +2,54 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
+#include <time.h>
 
+// 微秒精度的时间点
+// now()是墙上时间，可以格式化为日期；monotonicNow()是开机以来的单调时间，只用来算间隔
 class Timestamp
 {
 public:
     Timestamp();
     // explicit 防止类构造函数的隐式自动转换.参数个数 > 1 就失效了
     explicit Timestamp(int64_t microSecondsSinceEpoch) ; 
+    // CLOCK_REALTIME
     static Timestamp now();
+    // CLOCK_MONOTONIC，不受系统时间调整影响，不能与now()的结果混用
+    static Timestamp monotonicNow();
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
     // 将时间转换为年月日时分秒的格式
     std::string toString() const;
+    // 年/月/日 时:分:秒.微秒
+    std::string toFormattedString() const;
+    // 同toFormattedString，写到buf中，返回长度（不含'\0'），size至少为kFormattedSize
+    // 每个线程缓存上一次格式化的"年/月/日 时:分:秒"，同一秒内只改写微秒部分，日志每行都会调用
+    size_t formatTo(char *buf, size_t size) const;
+
+    static const int64_t kMicroSecondsPerSecond = 1000 * 1000;
+    static const size_t kFormattedSize = 32;
+
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
@@ -0,0 +1,74 @@
+#include "TokenBucket.h"
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(rate)
+    , burst_(burst > 0.0 ? burst : rate)
+    , tokens_(burst_)
+    , lastRefill_(0)
+{
+}
+
+void TokenBucket::reset(double rate, double burst)
+{
+    rate_ = rate;
+    burst_ = burst > 0.0 ? burst : rate;
+    tokens_ = burst_;
+    lastRefill_ = 0;
+}
+
+void TokenBucket::refill(int64_t now)
+{
+    if(lastRefill_ != 0 && now > lastRefill_)
+    {
+        tokens_ += rate_ * static_cast<double>(now - lastRefill_) / 1000000.0;
+        if(tokens_ > burst_)
+        {
+            tokens_ = burst_;
+        }
+    }
+    lastRefill_ = now;
+}
+
+double TokenBucket::available(int64_t now)
+{
+    refill(now);
+    return tokens_;
+}
+
+bool TokenBucket::tryConsume(double n, int64_t now)
+{
+    if(unlimited())
+    {
+        return true;
+    }
+    refill(now);
+    if(tokens_ >= n)
+    {
+        tokens_ -= n;
+        return true;
+    }
+    return false;
+}
+
+void TokenBucket::consume(double n, int64_t now)
+{
+    if(!unlimited())
+    {
+        refill(now);
+        tokens_ -= n;
+    }
+}
+
+int64_t TokenBucket::delayFor(double n, int64_t now)
+{
+    if(unlimited())
+    {
+        return 0;
+    }
+    refill(now);
+    if(tokens_ >= n)
+    {
+        return 0;
+    }
+    return static_cast<int64_t>((n - tokens_) / rate_ * 1000000.0) + 1;
+}
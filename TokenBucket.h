@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// 令牌桶：以rate个/秒的速度产生令牌，最多积攒burst个
+// 时间由调用者传入（单调时钟微秒，见Timer::now()），本身不加锁，只在一个loop线程中使用
+class TokenBucket
+{
+public:
+    // rate <= 0 表示不限速
+    explicit TokenBucket(double rate = 0.0, double burst = 0.0);
+
+    void reset(double rate, double burst);
+
+    bool unlimited() const { return rate_ <= 0.0; }
+    double rate() const { return rate_; }
+    double burst() const { return burst_; }
+
+    // 当前可用的令牌数，可能为负（之前透支了）
+    double available(int64_t now);
+    // 令牌足够时扣除n个并返回true
+    bool tryConsume(double n, int64_t now);
+    // 无条件扣除n个，允许透支，适合先读写再记账的场景
+    void consume(double n, int64_t now);
+    // 攒够n个令牌还需要等待的微秒数，0表示现在就够
+    int64_t delayFor(double n, int64_t now);
+
+private:
+    void refill(int64_t now);
+
+    double rate_;
+    double burst_;
+    double tokens_;
+    int64_t lastRefill_; // 0表示还没有开始计时
+};
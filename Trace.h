@@ -0,0 +1,34 @@
+#pragma once
+
+// USDT静态探针，供bpftrace/perf在不重新编译的情况下跟踪热路径
+// 有<sys/sdt.h>（systemtap-sdt-dev）时，每个探针编译成一条nop，并在.note.stapsdt段登记参数位置，
+// 没有挂载探针时只有参数求值的开销；没有该头文件或定义了MYMUDUO_NO_SDT时探针为空
+// 探针的provider为mymuduo，例如：
+//   bpftrace -e 'usdt:/usr/lib/libmymuduo.so:mymuduo:poll_return { @[arg1] = count(); }'
+// 现有探针及参数：
+//   poll_enter(loop)                      poll_return(loop, numEvents)
+//   channel_enter(fd, revents)            channel_return(fd)
+//   accept(connfd)
+//   conn_established(connId, fd)          conn_destroyed(connId, fd)
+//   read(fd, n)                           n为readv的返回值，-1表示出错
+//   write(fd, n)                          n为write的返回值
+//   write_eagain(fd, len)                 内核发送缓冲区满，len为未能写出的字节数
+//   high_water_mark(connId, bytes)        outputBuffer_越过高水位
+//   functor_queue(loop, depth)            depth为入队后队列长度
+//   functor_dequeue(loop, count)          一次取出count个回调执行
+// tools/bpftrace/下有基于这些探针的延迟直方图脚本
+
+#if !defined(MYMUDUO_NO_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define MYMUDUO_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef MYMUDUO_HAVE_SDT
+#include <sys/sdt.h>
+#define MYMUDUO_PROBE1(name, a1) DTRACE_PROBE1(mymuduo, name, a1)
+#define MYMUDUO_PROBE2(name, a1, a2) DTRACE_PROBE2(mymuduo, name, a1, a2)
+#else
+#define MYMUDUO_PROBE1(name, a1) do {} while(0)
+#define MYMUDUO_PROBE2(name, a1, a2) do {} while(0)
+#endif
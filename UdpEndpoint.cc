@@ -0,0 +1,345 @@
+#include "UdpEndpoint.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+const size_t UdpEndpoint::kDefaultBatchSize;
+const size_t UdpEndpoint::kDefaultMaxDatagramSize;
+const size_t UdpEndpoint::kMaxPendingBytes;
+const size_t UdpEndpoint::kMaxBatchesPerRead;
+const size_t UdpEndpoint::kMaxGsoSegments;
+const size_t UdpEndpoint::kMaxGsoSegmentSize;
+const size_t UdpEndpoint::kMaxGsoBytes;
+
+// 每个发送消息预留的控制消息空间，放一个uint16_t的GSO段长
+static const size_t kControlSpace = CMSG_SPACE(sizeof(uint16_t));
+// UDP载荷的理论上限
+static const size_t kMaxUdpPayload = 65507;
+
+static int createNonblockingUdp()
+{
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if(sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static bool samePeer(const sockaddr_in &a, const sockaddr_in &b)
+{
+    return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr;
+}
+
+UdpEndpoint::UdpEndpoint(EventLoop *loop,
+                const InetAddress &bindAddr,
+                bool reusePort,
+                size_t batchSize,
+                size_t maxDatagramSize)
+    : loop_(loop)
+    , socket_(createNonblockingUdp())
+    , channel_(loop, socket_.fd())
+    , batchSize_(batchSize)
+    , maxDatagramSize_(maxDatagramSize)
+    , recvBuffer_(batchSize * maxDatagramSize)
+    , recvMsgs_(batchSize)
+    , recvIovecs_(batchSize)
+    , recvAddrs_(batchSize)
+    , datagrams_(batchSize)
+    , flushQueued_(false)
+    , gso_(false)
+    , sendMsgs_(batchSize)
+    , sendIovecs_(batchSize)
+    , sendControl_(batchSize * kControlSpace)
+    , sendCovers_(batchSize)
+    , received_(0)
+    , sent_(0)
+    , dropped_(0)
+    , truncated_(0)
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(reusePort);
+    socket_.bindAddress(bindAddr);
+
+    // 接收槽和msghdr的对应关系固定不变，收取前只需重置地址长度
+    for(size_t i = 0; i < batchSize_; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvBuffer_[i * maxDatagramSize_];
+        recvIovecs_[i].iov_len = maxDatagramSize_;
+        ::bzero(&recvMsgs_[i], sizeof(mmsghdr));
+        recvMsgs_[i].msg_hdr.msg_name = &recvAddrs_[i];
+        recvMsgs_[i].msg_hdr.msg_iov = &recvIovecs_[i];
+        recvMsgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+    channel_.setHandler(this);
+}
+
+UdpEndpoint::~UdpEndpoint()
+{
+}
+
+bool UdpEndpoint::enableGso()
+{
+    int segment = 0;
+    socklen_t len = sizeof segment;
+    if(::getsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &segment, &len) < 0)
+    {
+        LOG_ERROR("UdpEndpoint::enableGso UDP_SEGMENT not supported, errno:%d \n", errno);
+        return false;
+    }
+    gso_ = true;
+    return true;
+}
+
+InetAddress UdpEndpoint::localAddress() const
+{
+    sockaddr_in local;
+    ::bzero(&local, sizeof local);
+    socklen_t addrlen = sizeof local;
+    ::getsockname(socket_.fd(), (sockaddr*)&local, &addrlen);
+    return InetAddress(local);
+}
+
+void UdpEndpoint::start()
+{
+    loop_->runInLoop(std::bind(&UdpEndpoint::startInLoop, shared_from_this()));
+}
+
+void UdpEndpoint::startInLoop()
+{
+    channel_.tie(shared_from_this());
+    channel_.enableReading();
+}
+
+void UdpEndpoint::stop()
+{
+    channel_.disableAll();
+    channel_.remove();
+}
+
+void UdpEndpoint::handleRead(Timestamp receiveTime)
+{
+    for(size_t round = 0; round < kMaxBatchesPerRead; ++round)
+    {
+        for(size_t i = 0; i < batchSize_; ++i)
+        {
+            recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            recvMsgs_[i].msg_hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), static_cast<unsigned int>(batchSize_), MSG_DONTWAIT, nullptr);
+        if(n < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpEndpoint::handleRead recvmmsg errno:%d \n", errno);
+            }
+            return;
+        }
+
+        size_t count = 0;
+        for(int i = 0; i < n; ++i)
+        {
+            if(recvMsgs_[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                truncated_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            UdpDatagram &datagram = datagrams_[count++];
+            datagram.data = static_cast<const char*>(recvIovecs_[i].iov_base);
+            datagram.len = recvMsgs_[i].msg_len;
+            datagram.peer.setSockAddr(recvAddrs_[i]);
+        }
+        received_.fetch_add(count, std::memory_order_relaxed);
+        if(count > 0 && messageCallback_)
+        {
+            messageCallback_(this, datagrams_.data(), count, receiveTime);
+        }
+        // 没收满一批说明socket已经读空
+        if(static_cast<size_t>(n) < batchSize_)
+        {
+            return;
+        }
+    }
+}
+
+void UdpEndpoint::send(const void *data, size_t len, const InetAddress &peer)
+{
+    if(loop_->isInLoopThread())
+    {
+        sendInLoop(data, len, *peer.getSockAddr());
+    }
+    else
+    {
+        std::shared_ptr<std::string> copy(std::make_shared<std::string>(static_cast<const char*>(data), len));
+        std::shared_ptr<UdpEndpoint> self(shared_from_this());
+        sockaddr_in addr = *peer.getSockAddr();
+        loop_->runInLoop([self, copy, addr]() {
+            self->sendInLoop(copy->data(), copy->size(), addr);
+        });
+    }
+}
+
+void UdpEndpoint::sendInLoop(const void *data, size_t len, const sockaddr_in &peer)
+{
+    if(len > kMaxUdpPayload || sendBuffer_.size() + len > kMaxPendingBytes)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Pending pending;
+    pending.offset = sendBuffer_.size();
+    pending.len = len;
+    pending.peer = peer;
+    sendBuffer_.insert(sendBuffer_.end(), static_cast<const char*>(data), static_cast<const char*>(data) + len);
+    pending_.push_back(pending);
+
+    // 本轮loop的回调都执行完后统一发送；正在等可写时由handleWrite发送
+    if(!flushQueued_ && !channel_.isWriting())
+    {
+        flushQueued_ = true;
+        std::weak_ptr<UdpEndpoint> weakSelf(shared_from_this());
+        loop_->queueInLoop([weakSelf]() {
+            std::shared_ptr<UdpEndpoint> self = weakSelf.lock();
+            if(self)
+            {
+                self->flush();
+            }
+        });
+    }
+}
+
+size_t UdpEndpoint::buildMessage(size_t first, mmsghdr *msg, iovec *iov, char *control)
+{
+    const Pending &head = pending_[first];
+    size_t count = 1;
+    size_t total = head.len;
+    // 合并发往同一对端的连续数据报：除最后一个外长度都等于段长，最后一个可以更短
+    if(gso_ && head.len > 0 && head.len <= kMaxGsoSegmentSize)
+    {
+        while(first + count < pending_.size() && count < kMaxGsoSegments)
+        {
+            const Pending &next = pending_[first + count];
+            if(next.len == 0 || next.len > head.len || total + next.len > kMaxGsoBytes || !samePeer(head.peer, next.peer))
+            {
+                break;
+            }
+            total += next.len;
+            ++count;
+            if(next.len < head.len)
+            {
+                break;
+            }
+        }
+    }
+
+    // 同一组数据报在sendBuffer_中是连续的，一个iovec即可
+    iov->iov_base = &sendBuffer_[head.offset];
+    iov->iov_len = total;
+    ::bzero(msg, sizeof(mmsghdr));
+    msg->msg_hdr.msg_name = const_cast<sockaddr_in*>(&head.peer);
+    msg->msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    msg->msg_hdr.msg_iov = iov;
+    msg->msg_hdr.msg_iovlen = 1;
+    if(count > 1)
+    {
+        msg->msg_hdr.msg_control = control;
+        msg->msg_hdr.msg_controllen = kControlSpace;
+        cmsghdr *cm = CMSG_FIRSTHDR(&msg->msg_hdr);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t segment = static_cast<uint16_t>(head.len);
+        ::memcpy(CMSG_DATA(cm), &segment, sizeof segment);
+    }
+    return count;
+}
+
+void UdpEndpoint::flush()
+{
+    flushQueued_ = false;
+    size_t done = 0;
+    while(done < pending_.size())
+    {
+        size_t numMsgs = 0;
+        for(size_t next = done; numMsgs < batchSize_ && next < pending_.size(); ++numMsgs)
+        {
+            sendCovers_[numMsgs] = buildMessage(next, &sendMsgs_[numMsgs], &sendIovecs_[numMsgs],
+                &sendControl_[numMsgs * kControlSpace]);
+            next += sendCovers_[numMsgs];
+        }
+
+        int n = ::sendmmsg(socket_.fd(), sendMsgs_.data(), static_cast<unsigned int>(numMsgs), 0);
+        if(n < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            if(gso_ && sendCovers_[0] > 1 && (errno == EIO || errno == EINVAL))
+            {
+                // 网卡或路径不支持GSO，退回逐个发送
+                LOG_ERROR("UdpEndpoint::flush UDP_SEGMENT failed errno:%d, disable GSO \n", errno);
+                gso_ = false;
+                continue;
+            }
+            // 其他错误（如对端不可达）只影响第一个消息，丢弃后继续
+            LOG_ERROR("UdpEndpoint::flush sendmmsg errno:%d \n", errno);
+            dropped_.fetch_add(sendCovers_[0], std::memory_order_relaxed);
+            done += sendCovers_[0];
+            continue;
+        }
+        for(int i = 0; i < n; ++i)
+        {
+            done += sendCovers_[i];
+            sent_.fetch_add(sendCovers_[i], std::memory_order_relaxed);
+        }
+    }
+
+    if(done == pending_.size())
+    {
+        pending_.clear();
+        sendBuffer_.clear();
+        if(channel_.isWriting())
+        {
+            channel_.disableWriting();
+        }
+    }
+    else
+    {
+        // socket发送缓冲区满了，剩下的挪到队首，等可写时再发
+        size_t consumed = pending_[done].offset;
+        pending_.erase(pending_.begin(), pending_.begin() + done);
+        for(Pending &pending : pending_)
+        {
+            pending.offset -= consumed;
+        }
+        sendBuffer_.erase(sendBuffer_.begin(), sendBuffer_.begin() + consumed);
+        if(!channel_.isWriting())
+        {
+            channel_.enableWriting();
+        }
+    }
+}
+
+void UdpEndpoint::handleWrite()
+{
+    flush();
+}
+
+void UdpEndpoint::handleError()
+{
+    int optval = 0;
+    socklen_t optlen = sizeof optval;
+    ::getsockopt(socket_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen);
+    LOG_ERROR("UdpEndpoint::handleError fd=%d SO_ERROR:%d \n", socket_.fd(), optval);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+class EventLoop;
+
+// 收到的一个数据报，data指向UdpEndpoint预分配的接收槽，只在回调期间有效
+struct UdpDatagram
+{
+    const char *data;
+    size_t len;
+    InetAddress peer;
+};
+
+// 绑定在一个loop上的UDP socket，类比TcpConnection，只在所属loop线程中收发，须由shared_ptr管理
+// 1. 可读时用recvmmsg一次收取一批数据报到预分配的接收槽中，整批交给一次回调
+// 2. 同一轮loop中的send()先攒起来，本轮回调结束后用一次sendmmsg发出
+// 3. 可选UDP_SEGMENT(GSO)：发往同一对端、大小相同的连续数据报合成一个大包交给内核切分
+class UdpEndpoint : noncopyable,
+                    public std::enable_shared_from_this<UdpEndpoint>,
+                    private ChannelHandler
+{
+public:
+    // 一批数据报，datagrams[0, count)
+    using MessageCallback = std::function<void(UdpEndpoint*, const UdpDatagram *datagrams, size_t count, Timestamp)>;
+
+    static const size_t kDefaultBatchSize = 64;
+    static const size_t kDefaultMaxDatagramSize = 2048;
+    static const size_t kMaxPendingBytes = 4 * 1024 * 1024; // 发送积压上限，超过则丢弃
+    static const size_t kMaxBatchesPerRead = 4;  // 一次可读事件最多收几批，避免饿死同loop的其他fd
+    static const size_t kMaxGsoSegments = 64;    // 内核UDP_MAX_SEGMENTS
+    static const size_t kMaxGsoSegmentSize = 1472; // 按1500的以太网MTU，超过的数据报不合并
+    static const size_t kMaxGsoBytes = 65000;    // 合并后的UDP载荷上限
+
+    // reusePort为true时多个loop可以各自bind同一端口，由内核按四元组分流
+    UdpEndpoint(EventLoop *loop,
+                const InetAddress &bindAddr,
+                bool reusePort,
+                size_t batchSize = kDefaultBatchSize,
+                size_t maxDatagramSize = kDefaultMaxDatagramSize);
+    ~UdpEndpoint();
+
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    // 开启GSO，内核不支持时返回false并保持关闭，须在loop线程中调用
+    bool enableGso();
+
+    // 开始接收，可在任意线程调用
+    void start();
+    // 停止接收，须在loop线程中调用，析构前调用
+    void stop();
+
+    // 发送一个数据报；loop线程中调用时只拷贝到发送队列，本轮结束时批量发出
+    void send(const void *data, size_t len, const InetAddress &peer);
+    void send(const std::string &data, const InetAddress &peer) { send(data.data(), data.size(), peer); }
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    InetAddress localAddress() const;
+
+    // 计数，可在任意线程读取
+    uint64_t numReceived() const { return received_.load(std::memory_order_relaxed); }
+    uint64_t numSent() const { return sent_.load(std::memory_order_relaxed); }
+    uint64_t numDropped() const { return dropped_.load(std::memory_order_relaxed); }     // 发送积压或发送失败丢弃的
+    uint64_t numTruncated() const { return truncated_.load(std::memory_order_relaxed); } // 超过maxDatagramSize被丢弃的
+
+private:
+    // 待发送的数据报，数据在sendBuffer_中连续存放
+    struct Pending
+    {
+        size_t offset;
+        size_t len;
+        sockaddr_in peer;
+    };
+
+    void handleRead(Timestamp receiveTime) override;
+    void handleWrite() override;
+    void handleClose() override {}
+    void handleError() override;
+
+    void startInLoop();
+    void sendInLoop(const void *data, size_t len, const sockaddr_in &peer);
+    // 把发送队列尽量发完，EAGAIN时关注可写事件
+    void flush();
+    // 从pending_[first]开始组一个消息，返回覆盖的数据报个数
+    size_t buildMessage(size_t first, mmsghdr *msg, iovec *iov, char *control);
+
+    EventLoop *loop_;
+    Socket socket_;
+    Channel channel_;
+    MessageCallback messageCallback_;
+
+    const size_t batchSize_;
+    const size_t maxDatagramSize_;
+
+    // 接收槽，构造时一次分配
+    std::vector<char> recvBuffer_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIovecs_;
+    std::vector<sockaddr_in> recvAddrs_;
+    std::vector<UdpDatagram> datagrams_;
+
+    // 发送队列
+    std::vector<char> sendBuffer_;
+    std::vector<Pending> pending_;
+    bool flushQueued_;
+    bool gso_;
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<iovec> sendIovecs_;
+    std::vector<char> sendControl_; // 每个消息一个UDP_SEGMENT控制消息
+    std::vector<size_t> sendCovers_; // 每个消息包含的数据报个数
+
+    std::atomic<uint64_t> received_;
+    std::atomic<uint64_t> sent_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> truncated_;
+};
@@ -0,0 +1,107 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <future>
+
+static EventLoop* CheckLoopNotNull(EventLoop *loop)
+{
+    if(loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+UdpServer::UdpServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &nameArg)
+                : loop_(CheckLoopNotNull(loop))
+                , listenAddr_(listenAddr)
+                , name_(nameArg)
+                , threadPool_(new EventLoopThreadPool(loop, nameArg))
+                , batchSize_(UdpEndpoint::kDefaultBatchSize)
+                , maxDatagramSize_(UdpEndpoint::kDefaultMaxDatagramSize)
+                , gso_(false)
+                , started_(0)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    // endpoint只能在其loop线程中停止，等停止完成后再释放
+    for(EndpointPtr &endpoint : endpoints_)
+    {
+        EventLoop *ioLoop = endpoint->getLoop();
+        if(ioLoop->isInLoopThread())
+        {
+            endpoint->stop();
+        }
+        else
+        {
+            std::promise<void> done;
+            ioLoop->runInLoop([&endpoint, &done]() {
+                endpoint->stop();
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+    if(started_++ == 0)
+    {
+        threadPool_->start(threadInitCallback_);
+        for(EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            // 一个loop时不需要SO_REUSEPORT，但打开也无妨，方便和其他进程共享端口
+            EndpointPtr endpoint(std::make_shared<UdpEndpoint>(ioLoop, listenAddr_, true, batchSize_, maxDatagramSize_));
+            endpoint->setMessageCallback(messageCallback_);
+            if(gso_)
+            {
+                ioLoop->runInLoop([endpoint]() { endpoint->enableGso(); });
+            }
+            endpoint->start();
+            endpoints_.push_back(endpoint);
+        }
+        LOG_INFO("UdpServer::start [%s] - %lu endpoints on %s \n",
+            name_.c_str(), endpoints_.size(), listenAddr_.toIpPort().c_str());
+    }
+}
+
+uint64_t UdpServer::numReceived() const
+{
+    uint64_t n = 0;
+    for(const EndpointPtr &endpoint : endpoints_)
+    {
+        n += endpoint->numReceived();
+    }
+    return n;
+}
+
+uint64_t UdpServer::numSent() const
+{
+    uint64_t n = 0;
+    for(const EndpointPtr &endpoint : endpoints_)
+    {
+        n += endpoint->numSent();
+    }
+    return n;
+}
+
+uint64_t UdpServer::numDropped() const
+{
+    uint64_t n = 0;
+    for(const EndpointPtr &endpoint : endpoints_)
+    {
+        n += endpoint->numDropped();
+    }
+    return n;
+}
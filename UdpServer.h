@@ -0,0 +1,62 @@
+#pragma once
+// 用户使用muduo编写UDP服务器程序
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "UdpEndpoint.h"
+#include "EventLoopThreadPool.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+// 每个subLoop一个UdpEndpoint，都用SO_REUSEPORT绑定同一端口，内核按四元组把数据报分到各个socket
+// 同一对端的数据报总是落到同一个loop，回调中可以直接通过endpoint回复
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    UdpServer(EventLoop *loop,
+                const InetAddress &listenAddr,
+                const std::string &nameArg);
+    ~UdpServer();
+
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    // 下面的设置须在start()之前
+    void setMessageCallback(const UdpEndpoint::MessageCallback &cb) { messageCallback_ = cb; }
+    void setThreadNum(int numThreads);
+    // 每次recvmmsg/sendmmsg的数据报个数和单个数据报的最大长度
+    void setBatchSize(size_t batchSize) { batchSize_ = batchSize; }
+    void setMaxDatagramSize(size_t maxDatagramSize) { maxDatagramSize_ = maxDatagramSize; }
+    void enableGso(bool on) { gso_ = on; }
+
+    void start();
+
+    const std::string& name() const { return name_; }
+
+    // 所有endpoint的计数之和，可在任意线程调用
+    uint64_t numReceived() const;
+    uint64_t numSent() const;
+    uint64_t numDropped() const;
+
+private:
+    using EndpointPtr = std::shared_ptr<UdpEndpoint>;
+
+    EventLoop *loop_; // baseLoop
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::unique_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpEndpoint::MessageCallback messageCallback_;
+    size_t batchSize_;
+    size_t maxDatagramSize_;
+    bool gso_;
+
+    std::atomic_int started_;
+    std::vector<EndpointPtr> endpoints_; // start()之后只读
+};
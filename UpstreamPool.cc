@@ -0,0 +1,224 @@
+#include "UpstreamPool.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+#include "TcpConnection.h"
+#include "TcpConnectionPool.h"
+
+#include <algorithm>
+#include <strings.h>
+#include <sys/socket.h>
+
+// 池析构后连接仍可能存活，关闭时只需在loop中销毁它
+static void detachedRemoveConnection(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+UpstreamPool::UpstreamPool(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg,
+                size_t maxIdle)
+                : loop_(loop)
+                , serverAddr_(serverAddr)
+                , name_(nameArg)
+                , maxIdle_(maxIdle)
+                , minIdle_(0)
+                , nextConnId_(1)
+{
+}
+
+UpstreamPool::~UpstreamPool()
+{
+    for(auto &item : connectors_)
+    {
+        item.second->stop();
+    }
+    CloseCallback cb = std::bind(&detachedRemoveConnection, loop_, std::placeholders::_1);
+    for(auto &item : connections_)
+    {
+        const TcpConnectionPtr &conn = item.second.conn;
+        // 关闭前可能还会收到数据，回调都不能再指回本对象
+        conn->setMessageCallback([](const TcpConnectionPtr&, Buffer *buf, Timestamp) { buf->retriveAll(); });
+        conn->setCloseCallback(cb);
+        conn->forceClose();
+    }
+}
+
+void UpstreamPool::setMinIdle(size_t minIdle)
+{
+    minIdle_ = std::min(minIdle, maxIdle_);
+    refill();
+}
+
+void UpstreamPool::prewarm(size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        startConnect();
+    }
+}
+
+void UpstreamPool::acquire(const AcquireCallback &cb)
+{
+    while(!idle_.empty())
+    {
+        TcpConnectionPtr conn(std::move(idle_.back()));
+        idle_.pop_back();
+        auto it = connections_.find(conn->id());
+        if(it != connections_.end() && conn->connected())
+        {
+            it->second.idle = false;
+            refill();
+            cb(conn);
+            return;
+        }
+    }
+    waiters_.push_back(cb);
+    refill();
+}
+
+void UpstreamPool::release(const TcpConnectionPtr &conn)
+{
+    auto it = connections_.find(conn->id());
+    if(it == connections_.end() || it->second.idle)
+    {
+        return;
+    }
+    if(conn->connected())
+    {
+        offer(conn);
+    }
+}
+
+void UpstreamPool::offer(const TcpConnectionPtr &conn)
+{
+    Entry &entry = connections_[conn->id()];
+    if(!waiters_.empty())
+    {
+        AcquireCallback cb(std::move(waiters_.front()));
+        waiters_.pop_front();
+        entry.idle = false;
+        cb(conn);
+    }
+    else if(idle_.size() < maxIdle_)
+    {
+        entry.idle = true;
+        idle_.push_back(conn);
+    }
+    else
+    {
+        entry.idle = false;
+        conn->shutdown();
+    }
+}
+
+void UpstreamPool::refill()
+{
+    size_t wanted = waiters_.size() + minIdle_;
+    size_t have = idle_.size() + connectors_.size();
+    for(; have < wanted; ++have)
+    {
+        startConnect();
+    }
+}
+
+void UpstreamPool::startConnect()
+{
+    if(!callbacks_)
+    {
+        std::shared_ptr<TcpConnectionCallbacks> callbacks = std::make_shared<TcpConnectionCallbacks>();
+        callbacks->namePrefix = name_ + "-" + serverAddr_.toIpPort();
+        callbacks->connectionCallback = connectionCallback_;
+        callbacks->messageCallback = std::bind(&UpstreamPool::onMessage, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+        callbacks->closeCallback = std::bind(&UpstreamPool::removeConnection, this, std::placeholders::_1);
+        callbacks_ = callbacks;
+    }
+
+    std::shared_ptr<Connector> connector(new Connector(loop_, serverAddr_));
+    connector->setNewConnectionCallback(std::bind(&UpstreamPool::newConnection, this,
+        connector.get(), std::placeholders::_1));
+    connector->setConnectFailedCallback(std::bind(&UpstreamPool::connectFailed, this,
+        connector.get(), std::placeholders::_1));
+    connectors_[connector.get()] = connector;
+    connector->start();
+}
+
+// 在Connector的回调中执行，Connector由其排队的resetChannel保活到本轮结束
+void UpstreamPool::newConnection(Connector *connector, int sockfd)
+{
+    connectors_.erase(connector);
+
+    TcpConnectionPtr conn(TcpConnectionPool::forCurrentThread()->create(
+                            loop_,
+                            nextConnId_++,
+                            callbacks_,
+                            sockfd,
+                            Socket::getLocalAddr(sockfd),
+                            serverAddr_));
+    Entry &entry = connections_[conn->id()];
+    entry.conn = conn;
+    entry.idle = false;
+    conn->connectEstablished();
+    if(conn->connected())
+    {
+        offer(conn);
+    }
+}
+
+// 在Connector排队的回调中执行，Connector由该回调保活
+void UpstreamPool::connectFailed(Connector *connector, int err)
+{
+    connectors_.erase(connector);
+    LOG_ERROR("UpstreamPool::connectFailed [%s] - connect %s error:%d \n",
+        name_.c_str(), serverAddr_.toIpPort().c_str(), err);
+    // 每个等待者对应一次建连，这次建连不会再成功，不重试，直接让等待者失败
+    if(!waiters_.empty())
+    {
+        AcquireCallback cb(std::move(waiters_.front()));
+        waiters_.pop_front();
+        cb(TcpConnectionPtr());
+    }
+}
+
+void UpstreamPool::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    auto it = connections_.find(conn->id());
+    if(it != connections_.end() && !it->second.idle)
+    {
+        if(messageCallback_)
+        {
+            messageCallback_(conn, buf, receiveTime);
+        }
+        return;
+    }
+    // 空闲连接收到数据说明协议状态已经不可信，不再复用
+    size_t unexpected = buf->readableBytes();
+    LOG_ERROR("UpstreamPool::onMessage [%s] - unexpected %lu bytes on idle connection %s \n",
+        name_.c_str(), unexpected, conn->name().c_str());
+    buf->retriveAll();
+    removeIdle(conn);
+    conn->forceClose();
+}
+
+void UpstreamPool::removeIdle(const TcpConnectionPtr &conn)
+{
+    auto it = connections_.find(conn->id());
+    if(it != connections_.end() && it->second.idle)
+    {
+        it->second.idle = false;
+        idle_.erase(std::remove(idle_.begin(), idle_.end(), conn), idle_.end());
+    }
+}
+
+void UpstreamPool::removeConnection(const TcpConnectionPtr &conn)
+{
+    LOG_INFO("UpstreamPool::removeConnection [%s] - connection %s \n",
+        name_.c_str(), conn->name().c_str());
+    removeIdle(conn);
+    connections_.erase(conn->id());
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    refill();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Connector;
+class EventLoop;
+
+// 到同一个上游地址的连接池，每个loop一个（one loop per thread），只在所属loop线程中使用，无需加锁
+// 请求路径上acquire()直接拿到已建立的空闲连接，用完release()放回，不必每次都做TCP握手
+// 一般在ThreadInitCallback中为每个subLoop创建一个，并用prewarm()预先建好连接
+class UpstreamPool : noncopyable
+{
+public:
+    // 拿到连接时回调，连接一定处于connected状态
+    using AcquireCallback = std::function<void(const TcpConnectionPtr&)>;
+
+    UpstreamPool(EventLoop *loop,
+                const InetAddress &serverAddr,
+                const std::string &nameArg,
+                size_t maxIdle = 16);
+    // 须在loop线程中析构，关闭池中所有连接
+    ~UpstreamPool();
+
+    // 池中所有连接共用的回调，须在第一次建立连接之前设置
+    // 连接被借出时由使用者根据conn区分响应，空闲连接上收到数据或被关闭时，连接会被移出池
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+
+    // 始终保持至少minIdle个空闲连接，被借走或断开后在后台补齐
+    void setMinIdle(size_t minIdle);
+    // 预先建立n个连接放入空闲列表
+    void prewarm(size_t n);
+
+    // 有空闲连接时立即回调，否则新建连接（失败则按退避重试），连上后回调
+    // 遇到不可重试的connect错误时以空的conn回调
+    void acquire(const AcquireCallback &cb);
+    // 归还借出的连接；池已满或连接已断开时关闭它
+    void release(const TcpConnectionPtr &conn);
+
+    EventLoop* getLoop() const { return loop_; }
+    size_t numIdle() const { return idle_.size(); }
+    size_t numConnections() const { return connections_.size(); }
+    size_t numPending() const { return connectors_.size(); }
+
+private:
+    void startConnect();
+    void newConnection(Connector *connector, int sockfd);
+    // 不可重试的connect错误，移除该Connector，让一个等待者以失败返回
+    void connectFailed(Connector *connector, int err);
+    void removeConnection(const TcpConnectionPtr &conn);
+    // 空闲连接上的数据不属于任何请求
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void removeIdle(const TcpConnectionPtr &conn);
+    // 把连接交给等待者或放入空闲列表，都不需要时关闭
+    void offer(const TcpConnectionPtr &conn);
+    // 需要的连接数 = 等待者 + minIdle，不足时发起新连接
+    void refill();
+
+    EventLoop *loop_;
+    const InetAddress serverAddr_;
+    const std::string name_;
+    const size_t maxIdle_;
+    size_t minIdle_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    TcpConnectionCallbacksPtr callbacks_; // 池中连接共享的回调表，第一次建连时生成
+
+    uint64_t nextConnId_;
+    struct Entry
+    {
+        TcpConnectionPtr conn;
+        bool idle;
+    };
+    // 所有连接（空闲和借出的），连接关闭时移除
+    std::unordered_map<uint64_t, Entry> connections_;
+    std::vector<TcpConnectionPtr> idle_; // 后进先出，优先复用最近用过的连接
+    std::deque<AcquireCallback> waiters_;
+    // 进行中的连接，成功后移除
+    std::unordered_map<Connector*, std::shared_ptr<Connector>> connectors_;
+};
@@ -0,0 +1,51 @@
+#include "AllocCounter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <malloc.h>
+
+namespace
+{
+    std::atomic<uint64_t> g_allocations(0);
+    std::atomic<uint64_t> g_allocatedBytes(0);
+    std::atomic<int64_t> g_liveBytes(0);
+
+    void* countedAlloc(size_t size)
+    {
+        void *p = ::malloc(size == 0 ? 1 : size);
+        if(p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        // 按malloc实际给出的大小统计，释放时才能对得上
+        size_t usable = ::malloc_usable_size(p);
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_allocatedBytes.fetch_add(usable, std::memory_order_relaxed);
+        g_liveBytes.fetch_add(static_cast<int64_t>(usable), std::memory_order_relaxed);
+        return p;
+    }
+
+    void countedFree(void *p)
+    {
+        if(p != nullptr)
+        {
+            g_liveBytes.fetch_sub(static_cast<int64_t>(::malloc_usable_size(p)), std::memory_order_relaxed);
+            ::free(p);
+        }
+    }
+}
+
+namespace AllocCounter
+{
+    uint64_t allocations() { return g_allocations.load(std::memory_order_relaxed); }
+    uint64_t allocatedBytes() { return g_allocatedBytes.load(std::memory_order_relaxed); }
+    int64_t liveBytes() { return g_liveBytes.load(std::memory_order_relaxed); }
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
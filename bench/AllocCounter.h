@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 替换全局operator new/delete，统计进程内的堆分配
+// 链接了AllocCounter.cc的程序才生效
+namespace AllocCounter
+{
+    uint64_t allocations();   // 累计分配次数
+    uint64_t allocatedBytes(); // 累计分配字节数
+    int64_t liveBytes();       // 当前仍未释放的字节数
+}
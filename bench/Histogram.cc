@@ -0,0 +1,133 @@
+#include "Histogram.h"
+
+#include <math.h>
+
+const int Histogram::kSubBucketBits;
+const int Histogram::kSubBucketCount;
+const int Histogram::kSubBucketHalfCount;
+const int Histogram::kMaxShift;
+
+Histogram::Histogram()
+    : counts_(kSubBucketCount + kMaxShift * kSubBucketHalfCount, 0)
+    , count_(0)
+    , min_(INT64_MAX)
+    , max_(0)
+    , sum_(0)
+{
+}
+
+// [0, 2048) 直接对应下标；之后按最高位分段，每段保留最高的11位
+int Histogram::indexOf(int64_t value)
+{
+    if(value < kSubBucketCount)
+    {
+        return value < 0 ? 0 : static_cast<int>(value);
+    }
+    int msb = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    int shift = msb - (kSubBucketBits - 1);
+    if(shift > kMaxShift)
+    {
+        return kSubBucketCount + kMaxShift * kSubBucketHalfCount - 1;
+    }
+    int sub = static_cast<int>(value >> shift); // [1024, 2048)
+    return kSubBucketCount + (shift - 1) * kSubBucketHalfCount + (sub - kSubBucketHalfCount);
+}
+
+int64_t Histogram::lowestEquivalent(int index)
+{
+    if(index < kSubBucketCount)
+    {
+        return index;
+    }
+    int shift = (index - kSubBucketCount) / kSubBucketHalfCount + 1;
+    int64_t sub = (index - kSubBucketCount) % kSubBucketHalfCount + kSubBucketHalfCount;
+    return sub << shift;
+}
+
+int64_t Histogram::highestEquivalent(int index)
+{
+    if(index < kSubBucketCount)
+    {
+        return index;
+    }
+    int shift = (index - kSubBucketCount) / kSubBucketHalfCount + 1;
+    return lowestEquivalent(index) + (static_cast<int64_t>(1) << shift) - 1;
+}
+
+void Histogram::record(int64_t value)
+{
+    ++counts_[indexOf(value)];
+    ++count_;
+    sum_ += value;
+    if(value < min_) min_ = value;
+    if(value > max_) max_ = value;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for(size_t i = 0; i < counts_.size(); ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if(other.count_ && other.min_ < min_) min_ = other.min_;
+    if(other.max_ > max_) max_ = other.max_;
+}
+
+void Histogram::reset()
+{
+    counts_.assign(counts_.size(), 0);
+    count_ = 0;
+    min_ = INT64_MAX;
+    max_ = 0;
+    sum_ = 0;
+}
+
+int64_t Histogram::percentile(double percentile) const
+{
+    if(count_ == 0)
+    {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(ceil(percentile / 100.0 * count_));
+    if(target == 0)
+    {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for(size_t i = 0; i < counts_.size(); ++i)
+    {
+        seen += counts_[i];
+        if(seen >= target)
+        {
+            int64_t value = highestEquivalent(static_cast<int>(i));
+            return value < max_ ? value : max_;
+        }
+    }
+    return max_;
+}
+
+void Histogram::dumpPercentiles(FILE *fp, double scale) const
+{
+    fprintf(fp, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    // 和HdrHistogram一样，每半个数量级（到1/(1-p)翻倍）输出5个点
+    const int kTicksPerHalfDistance = 5;
+    double p = 0.0;
+    while(true)
+    {
+        int64_t value = percentile(p);
+        uint64_t total = static_cast<uint64_t>(ceil(p / 100.0 * count_));
+        if(p >= 100.0 || total >= count_)
+        {
+            fprintf(fp, "%12.3f %1.12f %10llu\n", max_ / scale, 1.0, (unsigned long long)count_);
+            break;
+        }
+        fprintf(fp, "%12.3f %1.12f %10llu %14.2f\n",
+            value / scale, p / 100.0, (unsigned long long)total, 1.0 / (1.0 - p / 100.0));
+        double halfDistance = pow(2.0, floor(log2(100.0 / (100.0 - p))) + 1);
+        p += 100.0 / (halfDistance * kTicksPerHalfDistance);
+    }
+    fprintf(fp, "#[Mean    = %12.3f, Max     = %12.3f]\n", mean() / scale, max_ / scale);
+    fprintf(fp, "#[Min     = %12.3f, TotalCount = %10llu]\n", min() / scale, (unsigned long long)count_);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// HDR风格的直方图：对数分段、段内线性，任意量级上都保持约3位有效数字的精度
+// 值小于2048时每个值一个计数；之后每翻一倍分成1024个等宽的格子
+// 记录和合并都是O(1)/O(格子数)，不加锁，每个线程各自记录，结束后合并
+class Histogram
+{
+public:
+    static const int kSubBucketBits = 11;                    // 2048个线性格子
+    static const int kSubBucketCount = 1 << kSubBucketBits;
+    static const int kSubBucketHalfCount = kSubBucketCount / 2;
+    static const int kMaxShift = 40;                         // 可记录约 2^51 的值，单位ns时远超需要
+
+    Histogram();
+
+    void record(int64_t value);
+    void merge(const Histogram &other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    int64_t min() const { return count_ ? min_ : 0; }
+    int64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+    // percentile取值[0, 100]，返回落在该分位的格子的上界
+    int64_t percentile(double percentile) const;
+
+    // 以HdrHistogram的percentile distribution文本格式输出，可直接用HdrHistogram的plotter画图比较
+    // 值除以scale后输出，例如ns记录、scale=1000输出us
+    void dumpPercentiles(FILE *fp, double scale) const;
+
+private:
+    static int indexOf(int64_t value);
+    static int64_t lowestEquivalent(int index);
+    static int64_t highestEquivalent(int index);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    int64_t min_;
+    int64_t max_;
+    int64_t sum_;
+};
@@ -0,0 +1,150 @@
+// 短连接压测：客户端线程不停地 建连 -> 发一个小请求 -> 收到回显 -> 断开
+// 统计服务端每秒处理的连接数，以及每个连接在进程内引起的堆分配次数/字节数
+//
+// 用法: connchurn [-t 服务端subLoop数] [-c 客户端线程数] [-d 持续秒数] [-p 端口]
+
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "AllocCounter.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+namespace
+{
+    const char kRequest[] = "GET / HTTP/1.1\r\n\r\n";
+
+    std::atomic<uint64_t> g_connections(0);
+    std::atomic<uint64_t> g_failures(0);
+
+    // 一个客户端线程，直到deadline前不断短连接
+    void clientThread(uint16_t port, std::chrono::steady_clock::time_point deadline)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        char buf[256];
+        while(std::chrono::steady_clock::now() < deadline)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+            {
+                g_failures.fetch_add(1, std::memory_order_relaxed);
+                if(fd >= 0) ::close(fd);
+                continue;
+            }
+
+            size_t expected = sizeof kRequest - 1;
+            size_t received = 0;
+            if(::write(fd, kRequest, expected) == static_cast<ssize_t>(expected))
+            {
+                while(received < expected)
+                {
+                    ssize_t n = ::read(fd, buf, sizeof buf);
+                    if(n <= 0) break;
+                    received += n;
+                }
+            }
+
+            // RST关闭，客户端不留TIME_WAIT，避免本地端口耗尽
+            linger lin = {1, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+            ::close(fd);
+
+            if(received == expected)
+                g_connections.fetch_add(1, std::memory_order_relaxed);
+            else
+                g_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int serverThreads = 4;
+    int clientThreads = 4;
+    int seconds = 5;
+    uint16_t port = 9990;
+
+    int opt;
+    while((opt = ::getopt(argc, argv, "t:c:d:p:")) != -1)
+    {
+        switch(opt)
+        {
+        case 't': serverThreads = atoi(optarg); break;
+        case 'c': clientThreads = atoi(optarg); break;
+        case 'd': seconds = atoi(optarg); break;
+        case 'p': port = static_cast<uint16_t>(atoi(optarg)); break;
+        default:
+            fprintf(stderr, "usage: %s [-t serverThreads] [-c clientThreads] [-d seconds] [-p port]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // 库内部日志只保留FATAL，低于阈值的日志不做格式化，只保留压测结果
+    Logger::setLogLevel(FATAL);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "churn");
+    server.setThreadNum(serverThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf->retriveAllAsString());
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        // 预热：让对象池和各个vector达到稳定容量后再开始统计
+        std::vector<std::thread> clients;
+        auto warmup = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+        for(int i = 0; i < clientThreads; ++i)
+            clients.emplace_back(clientThread, port, warmup);
+        for(std::thread &t : clients) t.join();
+        clients.clear();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        g_connections = 0;
+        g_failures = 0;
+        uint64_t allocs0 = AllocCounter::allocations();
+        uint64_t bytes0 = AllocCounter::allocatedBytes();
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::seconds(seconds);
+        for(int i = 0; i < clientThreads; ++i)
+            clients.emplace_back(clientThread, port, deadline);
+        for(std::thread &t : clients) t.join();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // 等服务端处理完最后一批断开
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        uint64_t allocs = AllocCounter::allocations() - allocs0;
+        uint64_t bytes = AllocCounter::allocatedBytes() - bytes0;
+        uint64_t conns = g_connections.load();
+
+        printf("server threads     : %d\n", serverThreads);
+        printf("client threads     : %d\n", clientThreads);
+        printf("connections        : %llu (%llu failed)\n",
+            (unsigned long long)conns, (unsigned long long)g_failures.load());
+        printf("connections/sec    : %.0f\n", conns / elapsed);
+        printf("allocations/conn   : %.2f\n", conns ? (double)allocs / conns : 0.0);
+        printf("alloc bytes/conn   : %.0f\n", conns ? (double)bytes / conns : 0.0);
+        fflush(stdout);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,139 @@
+// 统计每个空闲连接的内存占用：
+// 1. 关键类型的sizeof
+// 2. 建立N个空闲连接前后进程堆上存活字节数的差值 / N
+// 内核socket缓冲区等不在统计范围内
+//
+// 用法: connfootprint [-n 连接数] [-t 服务端subLoop数] [-p 端口]
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "AllocCounter.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+namespace
+{
+    std::atomic<int> g_established(0);
+
+    // 尽量把fd上限调到硬上限，客户端和服务端各占一个fd
+    void raiseFdLimit(int wanted)
+    {
+        rlimit rl;
+        if(::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < static_cast<rlim_t>(wanted))
+        {
+            rl.rlim_cur = rl.rlim_max < static_cast<rlim_t>(wanted) ? rl.rlim_max : wanted;
+            ::setrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+
+    void waitFor(int established)
+    {
+        while(g_established.load() != established)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        // 等subLoop处理完本轮回调
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int numConns = 1000;
+    int serverThreads = 2;
+    uint16_t port = 9991;
+
+    int opt;
+    while((opt = ::getopt(argc, argv, "n:t:p:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n': numConns = atoi(optarg); break;
+        case 't': serverThreads = atoi(optarg); break;
+        case 'p': port = static_cast<uint16_t>(atoi(optarg)); break;
+        default:
+            fprintf(stderr, "usage: %s [-n connections] [-t serverThreads] [-p port]\n", argv[0]);
+            return 1;
+        }
+    }
+    raiseFdLimit(2 * numConns + 64);
+
+    printf("sizeof(TcpConnection)          : %zu\n", sizeof(TcpConnection));
+    printf("sizeof(Channel)                : %zu\n", sizeof(Channel));
+    printf("sizeof(Socket)                 : %zu\n", sizeof(Socket));
+    printf("sizeof(Buffer)                 : %zu\n", sizeof(Buffer));
+    printf("sizeof(InetAddress)            : %zu\n", sizeof(InetAddress));
+    printf("sizeof(TcpConnectionCallbacks) : %zu (shared)\n", sizeof(TcpConnectionCallbacks));
+
+    // 库内部日志只保留FATAL，低于阈值的日志不做格式化，只保留统计结果
+    Logger::setLogLevel(FATAL);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "footprint");
+    server.setThreadNum(serverThreads);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if(conn->connected())
+            g_established.fetch_add(1);
+        else
+            g_established.fetch_sub(1);
+    });
+    server.start();
+
+    std::thread driver([&]() {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        std::vector<int> fds;
+        fds.reserve(numConns);
+
+        // 先建一个连接再断开，让各个loop的惰性初始化（对象池等）不计入统计
+        int warm = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ::connect(warm, (sockaddr*)&addr, sizeof addr);
+        waitFor(1);
+        ::close(warm);
+        waitFor(0);
+
+        int64_t before = AllocCounter::liveBytes();
+        for(int i = 0; i < numConns; ++i)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+            {
+                fprintf(stderr, "connect #%d failed, stop at %d connections\n", i, i);
+                if(fd >= 0) ::close(fd);
+                break;
+            }
+            fds.push_back(fd);
+        }
+        waitFor(static_cast<int>(fds.size()));
+        int64_t after = AllocCounter::liveBytes();
+
+        int n = static_cast<int>(fds.size());
+        printf("idle connections               : %d\n", n);
+        printf("heap bytes/idle connection     : %.0f\n", n ? (double)(after - before) / n : 0.0);
+        fflush(stdout);
+
+        for(int fd : fds) ::close(fd);
+        waitFor(0);
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+    return 0;
+}
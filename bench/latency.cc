@@ -0,0 +1,395 @@
+// 请求/响应延迟测试：开环（open-loop）负载，按固定速率发请求，不等上一个请求返回
+// 每个请求的延迟从它"本该发出"的时刻算起，发送端被拖慢时排队的时间也计入延迟，
+// 避免闭环压测的coordinated omission（服务端卡顿时压测端跟着少发，尾延迟被掩盖）
+//
+// 服务端用任意原样回显的服务即可，例如 pingpong server；loopback TCP与Unix域socket的对比见 uds_vs_tcp.sh
+// 用法:
+//   latency [-a 服务端ip] [-p 端口 | -u unix路径] [-t loop线程数] [-c 连接数] [-r 每秒总请求数]
+//           [-s 请求字节数] [-d 持续秒数] [-w 预热秒数] [-o 直方图输出文件]
+// 输出 p50/p90/p99/p99.9/p99.99/max（us），-o 时把两份直方图以HdrHistogram格式写入文件
+
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Histogram.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    struct Options
+    {
+        Options() : ip("127.0.0.1"), port(9981), threads(1), connections(1), rate(10000),
+                    size(64), seconds(10), warmup(1) {}
+
+        std::string ip;
+        uint16_t port;
+        std::string unixPath; // 非空时连接Unix域socket，'@'开头为抽象命名空间
+        int threads;
+        int connections;
+        double rate;
+        int size;
+        int seconds;
+        int warmup;
+        std::string output;
+    };
+
+    int64_t nowNanos()
+    {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // 请求头，回显后原样带回
+    struct RequestHeader
+    {
+        int64_t intendedNanos; // 按固定速率计划的发送时刻
+        int64_t sentNanos;     // 实际发送时刻
+    };
+
+    class Benchmark;
+
+    // 每个loop线程一个，负责该线程上的连接、发送节奏和直方图，只在所属loop线程中访问
+    class Generator
+    {
+    public:
+        Generator(EventLoop *loop, Benchmark *owner, const Options &opt, double rate);
+
+        void addConnection(const InetAddress &serverAddr, const std::string &name);
+        void connect();
+        void disconnect();
+
+        // 在loop线程中调用，从startNanos开始按速率发送，到stopNanos为止；warmupEnd之前的响应不计入
+        void start(int64_t startNanos, int64_t warmupEndNanos, int64_t stopNanos);
+
+        const Histogram& corrected() const { return corrected_; }
+        const Histogram& uncorrected() const { return uncorrected_; }
+        uint64_t sent() const { return sent_; }
+        uint64_t received() const { return received_; }
+
+    private:
+        void onConnection(const TcpConnectionPtr &conn);
+        void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+        // 把到期的请求都发出去，再预约下一个请求的时刻
+        void sendDue();
+
+        EventLoop *loop_;
+        Benchmark *owner_;
+        const int size_;
+        const double intervalNanos_;
+        std::vector<std::unique_ptr<TcpClient>> clients_;
+        std::vector<TcpConnectionPtr> connections_;
+        size_t next_; // 轮流使用连接
+        std::string request_;
+
+        int64_t startNanos_;
+        int64_t warmupEndNanos_;
+        int64_t stopNanos_;
+        uint64_t scheduled_; // 已经排到的请求序号
+        uint64_t sent_;
+        uint64_t received_;
+        Histogram corrected_;   // 从计划发送时刻算起
+        Histogram uncorrected_; // 从实际发送时刻算起，仅作对照
+    };
+
+    class Benchmark
+    {
+    public:
+        Benchmark(EventLoop *loop, const Options &opt)
+            : loop_(loop)
+            , opt_(opt)
+            , threadPool_(loop, "latency")
+            , connected_(0)
+        {
+            threadPool_.setThreadNum(opt.threads);
+            threadPool_.start();
+            std::vector<EventLoop*> loops = threadPool_.getAllLoops();
+            for(EventLoop *ioLoop : loops)
+            {
+                generators_.emplace_back(new Generator(ioLoop, this, opt, opt.rate / loops.size()));
+            }
+            InetAddress serverAddr(opt.unixPath.empty() ? InetAddress(opt.port, opt.ip)
+                                                        : InetAddress::fromUnixPath(opt.unixPath));
+            for(int i = 0; i < opt.connections; ++i)
+            {
+                generators_[i % generators_.size()]->addConnection(serverAddr, "L" + std::to_string(i));
+            }
+        }
+
+        void start()
+        {
+            for(auto &generator : generators_)
+            {
+                generator->connect();
+            }
+        }
+
+        // 在各自的loop线程中调用
+        void onConnect()
+        {
+            if(++connected_ == opt_.connections)
+            {
+                loop_->queueInLoop(std::bind(&Benchmark::run, this));
+            }
+        }
+
+        void onDisconnect()
+        {
+            if(--connected_ == 0)
+            {
+                loop_->queueInLoop(std::bind(&Benchmark::report, this));
+            }
+        }
+
+    private:
+        void run()
+        {
+            fprintf(stderr, "all %d connections connected, %.0f req/s for %ds after %ds warmup\n",
+                opt_.connections, opt_.rate, opt_.seconds, opt_.warmup);
+            // 所有生成器使用同一个起点
+            int64_t start = nowNanos() + 10 * 1000 * 1000;
+            int64_t warmupEnd = start + static_cast<int64_t>(opt_.warmup) * 1000000000;
+            int64_t stop = warmupEnd + static_cast<int64_t>(opt_.seconds) * 1000000000;
+            for(auto &generator : generators_)
+            {
+                generator->start(start, warmupEnd, stop);
+            }
+            // 停止发送后再等一秒收尾，还没回来的请求记为丢失
+            double total = (stop - nowNanos()) / 1e9 + 1.0;
+            loop_->runAfter(total, std::bind(&Benchmark::stop, this));
+        }
+
+        void stop()
+        {
+            for(auto &generator : generators_)
+            {
+                generator->disconnect();
+            }
+        }
+
+        static void printLine(const char *name, const Histogram &h)
+        {
+            printf("%-12s p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f p99.99=%.1f max=%.1f mean=%.1f (us)\n",
+                name,
+                h.percentile(50) / 1e3, h.percentile(90) / 1e3, h.percentile(99) / 1e3,
+                h.percentile(99.9) / 1e3, h.percentile(99.99) / 1e3, h.max() / 1e3, h.mean() / 1e3);
+        }
+
+        void report()
+        {
+            Histogram corrected;
+            Histogram uncorrected;
+            uint64_t sent = 0;
+            uint64_t received = 0;
+            for(auto &generator : generators_)
+            {
+                corrected.merge(generator->corrected());
+                uncorrected.merge(generator->uncorrected());
+                sent += generator->sent();
+                received += generator->received();
+            }
+
+            printf("size=%d connections=%d threads=%d rate=%.0f seconds=%d sent=%llu received=%llu lost=%llu measured=%llu\n",
+                opt_.size, opt_.connections, opt_.threads, opt_.rate, opt_.seconds,
+                (unsigned long long)sent, (unsigned long long)received,
+                (unsigned long long)(sent - received), (unsigned long long)corrected.count());
+            printLine("corrected", corrected);
+            printLine("uncorrected", uncorrected);
+            fflush(stdout);
+
+            if(!opt_.output.empty())
+            {
+                FILE *fp = ::fopen(opt_.output.c_str(), "w");
+                if(fp == nullptr)
+                {
+                    fprintf(stderr, "open %s failed: %s\n", opt_.output.c_str(), strerror(errno));
+                }
+                else
+                {
+                    fprintf(fp, "# corrected latency (us), size=%d connections=%d threads=%d rate=%.0f\n",
+                        opt_.size, opt_.connections, opt_.threads, opt_.rate);
+                    corrected.dumpPercentiles(fp, 1e3);
+                    fprintf(fp, "\n# uncorrected latency (us)\n");
+                    uncorrected.dumpPercentiles(fp, 1e3);
+                    ::fclose(fp);
+                }
+            }
+            loop_->quit();
+        }
+
+        EventLoop *loop_;
+        Options opt_;
+        EventLoopThreadPool threadPool_;
+        std::vector<std::unique_ptr<Generator>> generators_;
+        std::atomic_int connected_;
+    };
+
+    Generator::Generator(EventLoop *loop, Benchmark *owner, const Options &opt, double rate)
+        : loop_(loop)
+        , owner_(owner)
+        , size_(opt.size)
+        , intervalNanos_(1e9 / rate)
+        , next_(0)
+        , request_(opt.size, 'x')
+        , startNanos_(0)
+        , warmupEndNanos_(0)
+        , stopNanos_(0)
+        , scheduled_(0)
+        , sent_(0)
+        , received_(0)
+    {
+    }
+
+    void Generator::addConnection(const InetAddress &serverAddr, const std::string &name)
+    {
+        TcpClient *client = new TcpClient(loop_, serverAddr, name);
+        client->setConnectionCallback(std::bind(&Generator::onConnection, this, std::placeholders::_1));
+        client->setMessageCallback(std::bind(&Generator::onMessage, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        clients_.emplace_back(client);
+    }
+
+    void Generator::connect()
+    {
+        for(auto &client : clients_)
+        {
+            client->connect();
+        }
+    }
+
+    void Generator::disconnect()
+    {
+        for(auto &client : clients_)
+        {
+            client->disconnect();
+        }
+    }
+
+    void Generator::onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            connections_.push_back(conn);
+            owner_->onConnect();
+        }
+        else
+        {
+            // 排到TcpClient移除连接之后再计数，见pingpong.cc
+            Benchmark *owner = owner_;
+            loop_->queueInLoop([owner]() { owner->onDisconnect(); });
+        }
+    }
+
+    void Generator::start(int64_t startNanos, int64_t warmupEndNanos, int64_t stopNanos)
+    {
+        loop_->runInLoop([this, startNanos, warmupEndNanos, stopNanos]() {
+            startNanos_ = startNanos;
+            warmupEndNanos_ = warmupEndNanos;
+            stopNanos_ = stopNanos;
+            sendDue();
+        });
+    }
+
+    void Generator::sendDue()
+    {
+        int64_t now = nowNanos();
+        while(true)
+        {
+            int64_t intended = startNanos_ + static_cast<int64_t>(scheduled_ * intervalNanos_);
+            if(intended >= stopNanos_ || connections_.empty())
+            {
+                return;
+            }
+            if(intended > now)
+            {
+                loop_->runAfter((intended - now) / 1e9, std::bind(&Generator::sendDue, this));
+                return;
+            }
+            // 落后于计划时（定时器迟到、loop被占用）一次补发所有到期的请求
+            RequestHeader header;
+            header.intendedNanos = intended;
+            header.sentNanos = nowNanos();
+            ::memcpy(&request_[0], &header, sizeof header);
+            connections_[next_++ % connections_.size()]->send(request_);
+            ++scheduled_;
+            ++sent_;
+        }
+    }
+
+    void Generator::onMessage(const TcpConnectionPtr&, Buffer *buf, Timestamp)
+    {
+        int64_t now = nowNanos();
+        while(buf->readableBytes() >= static_cast<size_t>(size_))
+        {
+            RequestHeader header;
+            ::memcpy(&header, buf->peek(), sizeof header);
+            buf->retrieve(size_);
+            ++received_;
+            if(header.intendedNanos >= warmupEndNanos_)
+            {
+                corrected_.record(now - header.intendedNanos);
+                uncorrected_.record(now - header.sentNanos);
+            }
+        }
+    }
+
+    void usage(const char *prog)
+    {
+        fprintf(stderr,
+            "usage: %s [-a ip] [-p port | -u unixPath] [-t threads] [-c connections] [-r requests/sec]\n"
+            "          [-s size] [-d seconds] [-w warmupSeconds] [-o histogramFile]\n", prog);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    int ch;
+    while((ch = ::getopt(argc, argv, "a:p:u:t:c:r:s:d:w:o:")) != -1)
+    {
+        switch(ch)
+        {
+        case 'a': opt.ip = optarg; break;
+        case 'p': opt.port = static_cast<uint16_t>(atoi(optarg)); break;
+        case 'u': opt.unixPath = optarg; break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'c': opt.connections = atoi(optarg); break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 's': opt.size = atoi(optarg); break;
+        case 'd': opt.seconds = atoi(optarg); break;
+        case 'w': opt.warmup = atoi(optarg); break;
+        case 'o': opt.output = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(opt.size < static_cast<int>(sizeof(RequestHeader)) || opt.rate <= 0
+        || opt.connections < opt.threads || opt.seconds <= 0)
+    {
+        fprintf(stderr, "size must be >= %zu, rate > 0, connections >= threads\n", sizeof(RequestHeader));
+        usage(argv[0]);
+        return 1;
+    }
+
+    // 库内部日志只保留FATAL，低于阈值的日志不做格式化，只保留压测结果
+    Logger::setLogLevel(FATAL);
+
+    EventLoop loop;
+    Benchmark bench(&loop, opt);
+    bench.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,275 @@
+// 热路径基本操作的微基准测试（Google Benchmark）
+// 1. Buffer: append/retrieve、makeSpace的扩容与挪动、retrieveAsString、readFd（socketpair）
+// 2. EventLoop: 1..N个生产者线程queueInLoop、跨线程runInLoop往返延迟
+// 3. EPollPoller: 通过Channel触发的epoll_ctl add/mod/del
+// 4. BinaryLog: 一条BLOG_INFO记录写入线程环形缓冲区的开销
+//
+// 用法:
+//   microbench [--benchmark_filter=正则] [--benchmark_repetitions=5 --benchmark_report_aggregates_only=true]
+//              [--benchmark_out=result.json --benchmark_out_format=json]
+// 不同提交的json结果可用Google Benchmark自带的tools/compare.py对比
+
+#include "BinaryLog.h"
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+namespace
+{
+    // 所有EventLoop相关用例共用的后台loop线程
+    EventLoop* backgroundLoop()
+    {
+        static EventLoopThread thread(EventLoopThread::ThreadInitCallback(), "microbench");
+        static EventLoop *loop = thread.startLoop();
+        return loop;
+    }
+
+    // 等后台loop执行完之前投递的所有任务
+    void drainLoop(EventLoop *loop)
+    {
+        std::atomic_bool done(false);
+        loop->queueInLoop([&done]() { done.store(true, std::memory_order_release); });
+        while(!done.load(std::memory_order_acquire))
+        {
+        }
+    }
+}
+
+// 追加后立即全部取走，缓冲区容量稳定后不再分配
+static void BM_BufferAppendRetrieve(benchmark::State &state)
+{
+    const size_t size = state.range(0);
+    std::string data(size, 'x');
+    Buffer buf;
+    for(auto _ : state)
+    {
+        buf.append(data.data(), size);
+        buf.retrieve(size);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BufferAppendRetrieve)->Arg(16)->Arg(256)->Arg(4096)->Arg(65536);
+
+// 每次留下半块未读数据，readerIndex_不断后移，触发makeSpace把数据挪回头部
+static void BM_BufferAppendCompact(benchmark::State &state)
+{
+    const size_t size = state.range(0);
+    std::string data(size, 'x');
+    Buffer buf;
+    buf.append(data.data(), size / 2);
+    for(auto _ : state)
+    {
+        buf.append(data.data(), size);
+        buf.retrieve(size);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BufferAppendCompact)->Arg(64)->Arg(512)->Arg(4096);
+
+// 从空Buffer以64字节为单位追加到指定大小，测vector扩容的代价
+static void BM_BufferGrow(benchmark::State &state)
+{
+    const size_t total = state.range(0);
+    char chunk[64] = {0};
+    for(auto _ : state)
+    {
+        Buffer buf;
+        for(size_t n = 0; n < total; n += sizeof chunk)
+        {
+            buf.append(chunk, sizeof chunk);
+        }
+        benchmark::DoNotOptimize(buf.peek());
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_BufferGrow)->Arg(4096)->Arg(65536)->Arg(1 << 20);
+
+static void BM_BufferRetrieveAsString(benchmark::State &state)
+{
+    const size_t size = state.range(0);
+    std::string data(size, 'x');
+    Buffer buf;
+    for(auto _ : state)
+    {
+        buf.append(data.data(), size);
+        std::string s = buf.retriveAllAsString();
+        benchmark::DoNotOptimize(s.data());
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BufferRetrieveAsString)->Arg(16)->Arg(256)->Arg(4096)->Arg(65536);
+
+// 一端write，另一端Buffer::readFd，包含两次系统调用
+static void BM_BufferReadFd(benchmark::State &state)
+{
+    const size_t size = state.range(0);
+    int fds[2];
+    if(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    // 保证一次write可以完整写入
+    int sndbuf = static_cast<int>(size * 4);
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof sndbuf);
+
+    std::string data(size, 'x');
+    Buffer buf;
+    int savedErrno = 0;
+    for(auto _ : state)
+    {
+        size_t written = 0;
+        while(written < size)
+        {
+            ssize_t n = ::write(fds[0], data.data() + written, size - written);
+            if(n <= 0) break;
+            written += n;
+            while(buf.readFd(fds[1], &savedErrno) > 0)
+            {
+            }
+        }
+        buf.retriveAll();
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+BENCHMARK(BM_BufferReadFd)->Arg(64)->Arg(4096)->Arg(65536)->Arg(256 * 1024);
+
+// N个线程同时向同一个loop投递任务，只统计投递端的耗时（加锁、入队、eventfd唤醒）
+static void BM_QueueInLoop(benchmark::State &state)
+{
+    static std::atomic<uint64_t> executed(0);
+    EventLoop *loop = backgroundLoop();
+    for(auto _ : state)
+    {
+        loop->queueInLoop([]() { executed.fetch_add(1, std::memory_order_relaxed); });
+    }
+    state.SetItemsProcessed(state.iterations());
+    // 循环结束后已不计时，等队列清空，避免积压影响下一组
+    if(state.thread_index() == 0)
+    {
+        drainLoop(loop);
+    }
+}
+BENCHMARK(BM_QueueInLoop)->ThreadRange(1, 8)->UseRealTime();
+
+// 向后台loop投递一个任务并忙等它执行完：一次跨线程往返的延迟
+static void BM_RunInLoopRoundTrip(benchmark::State &state)
+{
+    EventLoop *loop = backgroundLoop();
+    std::atomic<uint64_t> done(0);
+    uint64_t expected = 0;
+    for(auto _ : state)
+    {
+        ++expected;
+        loop->runInLoop([&done]() { done.fetch_add(1, std::memory_order_release); });
+        while(done.load(std::memory_order_acquire) != expected)
+        {
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RunInLoopRoundTrip)->UseRealTime();
+
+// 在loop线程内runInLoop直接执行，作为对照
+static void BM_RunInLoopSameThread(benchmark::State &state)
+{
+    EventLoop loop;
+    uint64_t count = 0;
+    for(auto _ : state)
+    {
+        loop.runInLoop([&count]() { ++count; });
+    }
+    benchmark::DoNotOptimize(count);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RunInLoopSameThread);
+
+// Channel注册到Poller（EPOLL_CTL_ADD）、修改关注事件（MOD）、移除（DEL）
+static void BM_PollerAddModDel(benchmark::State &state)
+{
+    EventLoop loop;
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    for(auto _ : state)
+    {
+        Channel channel(&loop, fd);
+        channel.enableReading();  // add
+        channel.enableWriting();  // mod
+        channel.disableAll();
+        channel.remove();         // del
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+    ::close(fd);
+}
+BENCHMARK(BM_PollerAddModDel);
+
+// 已注册的Channel反复切换写事件，只有EPOLL_CTL_MOD，对应TcpConnection发送时的enable/disableWriting
+static void BM_PollerModToggle(benchmark::State &state)
+{
+    EventLoop loop;
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(&loop, fd);
+    channel.enableReading();
+    for(auto _ : state)
+    {
+        channel.enableWriting();
+        channel.disableWriting();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    channel.disableAll();
+    channel.remove();
+    ::close(fd);
+}
+BENCHMARK(BM_PollerModToggle);
+
+// 后台线程每1ms收集一次，环足够大，不会因为环满丢弃而低估开销
+static void BM_BinaryLog(benchmark::State &state)
+{
+    BinaryLog::instance().start("/dev/null", 16 << 20, 1);
+    Logger::setLogLevel(INFO);
+    std::string name("conn-127.0.0.1:8000#1");
+    int n = 0;
+    for(auto _ : state)
+    {
+        BLOG_INFO("%s recv %d bytes", name.c_str(), ++n);
+    }
+    state.SetItemsProcessed(state.iterations());
+    Logger::setLogLevel(FATAL);
+    BinaryLog::instance().stop();
+    state.counters["dropped"] = static_cast<double>(BinaryLog::instance().numDropped());
+}
+BENCHMARK(BM_BinaryLog);
+
+int main(int argc, char *argv[])
+{
+    // 库内部日志只保留FATAL，不干扰Google Benchmark的控制台输出
+    Logger::setLogLevel(FATAL);
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    // 不带颜色控制符，输出可以直接diff
+    benchmark::ConsoleReporter reporter(benchmark::ConsoleReporter::OO_Tabular);
+    reporter.SetOutputStream(&std::cout);
+    reporter.SetErrorStream(&std::cerr);
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,281 @@
+// pingpong吞吐测试，参考muduo的pingpong benchmark
+// 服务端原样回显；客户端在多个loop上建立N个连接，每个连接先发一个size字节的数据块，
+// 之后收到多少回显多少，持续T秒后统计 MB/s 和 消息数/s（消息数 = 收到字节数 / size）
+//
+// 用法:
+//   pingpong server [-p 端口 | -u unix路径] [-t subLoop数]
+//   pingpong client [-a 服务端ip] [-p 端口 | -u unix路径] [-t loop线程数] [-c 连接数] [-s 消息字节数] [-d 持续秒数]
+// -u 改用Unix域socket，路径以'@'开头时为抽象命名空间
+// 客户端最后输出一行 key=value 形式的结果，便于sweep脚本汇总，见 pingpong_sweep.sh
+
+#include "TcpServer.h"
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+    struct Options
+    {
+        Options() : ip("127.0.0.1"), port(9981), threads(1), connections(1), size(4096), seconds(10) {}
+
+        std::string ip;
+        uint16_t port;
+        std::string unixPath;
+        int threads;
+        int connections;
+        int size;
+        int seconds;
+    };
+
+    InetAddress serverAddress(const Options &opt)
+    {
+        return opt.unixPath.empty() ? InetAddress(opt.port, opt.ip) : InetAddress::fromUnixPath(opt.unixPath);
+    }
+
+    int runServer(const Options &opt)
+    {
+        EventLoop loop;
+        InetAddress listenAddr(opt.unixPath.empty() ? InetAddress(opt.port) : InetAddress::fromUnixPath(opt.unixPath));
+        TcpServer server(&loop, listenAddr, "pingpong");
+        server.setThreadNum(opt.threads);
+        server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if(conn->connected())
+                conn->setTcpNoDelay(true);
+        });
+        server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            conn->send(buf);
+        });
+        server.start();
+        fprintf(stderr, "pingpong server on %s with %d threads\n", listenAddr.toIpPort().c_str(), opt.threads);
+        loop.loop();
+        return 0;
+    }
+
+    class Client;
+
+    // 一个客户端连接，计数只在其所属loop线程中修改
+    class Session
+    {
+    public:
+        Session(EventLoop *loop, const InetAddress &serverAddr, const std::string &name, Client *owner);
+
+        void start() { client_.connect(); }
+        void stop();
+
+        uint64_t bytesRead() const { return bytesRead_; }
+        uint64_t messagesRead() const { return messagesRead_; }
+
+    private:
+        void onConnection(const TcpConnectionPtr &conn);
+        void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp);
+
+        TcpClient client_;
+        Client *owner_;
+        uint64_t bytesRead_;
+        uint64_t messagesRead_;
+        uint64_t partial_; // 不足一个消息的字节数
+    };
+
+    class Client
+    {
+    public:
+        Client(EventLoop *loop, const Options &opt)
+            : loop_(loop)
+            , opt_(opt)
+            , message_(opt.size, 'x')
+            , threadPool_(loop, "pingpong-client")
+            , connected_(0)
+        {
+            for(int i = 0; i < opt.size; ++i)
+            {
+                message_[i] = static_cast<char>(i % 128);
+            }
+            threadPool_.setThreadNum(opt.threads);
+            threadPool_.start();
+
+            InetAddress serverAddr(serverAddress(opt));
+            for(int i = 0; i < opt.connections; ++i)
+            {
+                sessions_.emplace_back(new Session(threadPool_.getNextLoop(), serverAddr,
+                    "C" + std::to_string(i), this));
+            }
+        }
+
+        void start()
+        {
+            for(auto &session : sessions_)
+            {
+                session->start();
+            }
+        }
+
+        const std::string& message() const { return message_; }
+        int messageSize() const { return opt_.size; }
+
+        // 在各自的loop线程中调用
+        void onConnect()
+        {
+            if(++connected_ == opt_.connections)
+            {
+                loop_->queueInLoop([this]() {
+                    fprintf(stderr, "all %d connections connected\n", opt_.connections);
+                    loop_->runAfter(opt_.seconds, std::bind(&Client::timeout, this));
+                });
+            }
+        }
+
+        void onDisconnect()
+        {
+            if(--connected_ == 0)
+            {
+                loop_->queueInLoop(std::bind(&Client::report, this));
+            }
+        }
+
+    private:
+        void timeout()
+        {
+            for(auto &session : sessions_)
+            {
+                session->stop();
+            }
+        }
+
+        void report()
+        {
+            uint64_t bytes = 0;
+            uint64_t messages = 0;
+            for(auto &session : sessions_)
+            {
+                bytes += session->bytesRead();
+                messages += session->messagesRead();
+            }
+            double seconds = opt_.seconds;
+            printf("size=%d connections=%d threads=%d seconds=%d bytes=%llu messages=%llu MiB/s=%.2f msgs/s=%.0f\n",
+                opt_.size, opt_.connections, opt_.threads, opt_.seconds,
+                (unsigned long long)bytes, (unsigned long long)messages,
+                bytes / seconds / (1024 * 1024), messages / seconds);
+            fflush(stdout);
+            loop_->quit();
+        }
+
+        EventLoop *loop_;
+        Options opt_;
+        std::string message_;
+        EventLoopThreadPool threadPool_;
+        std::vector<std::unique_ptr<Session>> sessions_;
+        std::atomic_int connected_;
+    };
+
+    Session::Session(EventLoop *loop, const InetAddress &serverAddr, const std::string &name, Client *owner)
+        : client_(loop, serverAddr, name)
+        , owner_(owner)
+        , bytesRead_(0)
+        , messagesRead_(0)
+        , partial_(0)
+    {
+        client_.setConnectionCallback(std::bind(&Session::onConnection, this, std::placeholders::_1));
+        client_.setMessageCallback(std::bind(&Session::onMessage, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    void Session::stop()
+    {
+        client_.disconnect();
+    }
+
+    void Session::onConnection(const TcpConnectionPtr &conn)
+    {
+        if(conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+            conn->send(owner_->message());
+            owner_->onConnect();
+        }
+        else
+        {
+            // 断开回调在TcpClient移除连接之前执行，排到本轮之后再计数，
+            // 保证汇报结果、析构TcpClient时连接已经完全移除
+            Client *owner = owner_;
+            conn->getLoop()->queueInLoop([owner]() { owner->onDisconnect(); });
+        }
+    }
+
+    void Session::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        size_t n = buf->readableBytes();
+        bytesRead_ += n;
+        partial_ += n;
+        messagesRead_ += partial_ / owner_->messageSize();
+        partial_ %= owner_->messageSize();
+        conn->send(buf);
+    }
+
+    int runClient(const Options &opt)
+    {
+        EventLoop loop;
+        Client client(&loop, opt);
+        client.start();
+        loop.loop();
+        return 0;
+    }
+
+    void usage(const char *prog)
+    {
+        fprintf(stderr,
+            "usage: %s server [-p port | -u unixPath] [-t threads]\n"
+            "       %s client [-a ip] [-p port | -u unixPath] [-t threads] [-c connections] [-s size] [-d seconds]\n",
+            prog, prog);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || (strcmp(argv[1], "server") != 0 && strcmp(argv[1], "client") != 0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    bool server = strcmp(argv[1], "server") == 0;
+
+    Options opt;
+    int ch;
+    optind = 2;
+    while((ch = ::getopt(argc, argv, "a:p:u:t:c:s:d:")) != -1)
+    {
+        switch(ch)
+        {
+        case 'a': opt.ip = optarg; break;
+        case 'p': opt.port = static_cast<uint16_t>(atoi(optarg)); break;
+        case 'u': opt.unixPath = optarg; break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'c': opt.connections = atoi(optarg); break;
+        case 's': opt.size = atoi(optarg); break;
+        case 'd': opt.seconds = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(opt.size <= 0 || opt.connections <= 0 || opt.seconds <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // 库内部日志只保留FATAL，低于阈值的日志不做格式化，只保留压测结果
+    Logger::setLogLevel(FATAL);
+
+    return server ? runServer(opt) : runClient(opt);
+}
@@ -0,0 +1,30 @@
+#!/bin/bash
+# pingpong批量测试：对 消息大小 x 连接数 x 线程数 做笛卡尔积，每组启动一次服务端和客户端
+# 用法: ./pingpong_sweep.sh [pingpong可执行文件路径]
+# 可通过环境变量覆盖参数，例如 SIZES="1024 16384" CONNS="1 100" THREADS="1 4" SECONDS_PER_RUN=5
+set -e
+
+PINGPONG=${1:-./pingpong}
+PORT=${PORT:-9981}
+SIZES=${SIZES:-"16 1024 4096 16384 65536"}
+CONNS=${CONNS:-"1 10 100 1000"}
+THREADS=${THREADS:-"1 2 4"}
+DURATION=${SECONDS_PER_RUN:-10}
+
+echo "size conns threads MiB/s msgs/s"
+for threads in $THREADS; do
+    for conns in $CONNS; do
+        for size in $SIZES; do
+            # 服务端和客户端使用相同的loop线程数
+            $PINGPONG server -p $PORT -t $threads 2>/dev/null &
+            server=$!
+            sleep 0.5
+            result=$($PINGPONG client -p $PORT -t $threads -c $conns -s $size -d $DURATION 2>/dev/null)
+            kill $server
+            wait $server 2>/dev/null || true
+            mibs=$(echo "$result" | sed -n 's/.*MiB\/s=\([0-9.]*\).*/\1/p')
+            msgs=$(echo "$result" | sed -n 's/.*msgs\/s=\([0-9]*\).*/\1/p')
+            echo "$size $conns $threads $mibs $msgs"
+        done
+    done
+done
@@ -0,0 +1,47 @@
+#!/bin/bash
+# 同一负载下对比loopback TCP和Unix域socket的请求/响应延迟
+# 服务端是pingpong server（原样回显），客户端是开环的latency，两种传输各跑一遍
+# 用法: ./uds_vs_tcp.sh [pingpong路径] [latency路径]
+# 可通过环境变量覆盖参数，例如 SIZES="64 4096" RATE=20000 CONNS=10 SECONDS_PER_RUN=5
+set -e
+
+PINGPONG=${1:-./pingpong}
+LATENCY=${2:-./latency}
+PORT=${PORT:-9981}
+UDS=${UDS:-@mymuduo-uds-bench}
+SIZES=${SIZES:-"64 1024 16384"}
+RATE=${RATE:-10000}
+CONNS=${CONNS:-1}
+THREADS=${THREADS:-1}
+DURATION=${SECONDS_PER_RUN:-10}
+
+run()
+{
+    local transport=$1 size=$2 listen client
+    if [ "$transport" = tcp ]; then
+        listen="-p $PORT"
+        client="-p $PORT"
+    else
+        listen="-u $UDS"
+        client="-u $UDS"
+    fi
+    $PINGPONG server $listen -t $THREADS 2>/dev/null &
+    local server=$!
+    sleep 0.5
+    local result=$($LATENCY $client -t $THREADS -c $CONNS -r $RATE -s $size -d $DURATION 2>/dev/null)
+    kill $server
+    wait $server 2>/dev/null || true
+    # 只取计入coordinated omission修正的那一行
+    local line=$(echo "$result" | grep '^corrected')
+    local p50=$(echo "$line" | sed -n 's/.* p50=\([0-9.]*\).*/\1/p')
+    local p99=$(echo "$line" | sed -n 's/.* p99=\([0-9.]*\).*/\1/p')
+    local p999=$(echo "$line" | sed -n 's/.* p99.9=\([0-9.]*\).*/\1/p')
+    local max=$(echo "$line" | sed -n 's/.* max=\([0-9.]*\).*/\1/p')
+    echo "$transport $size $p50 $p99 $p999 $max"
+}
+
+echo "transport size p50(us) p99(us) p99.9(us) max(us)"
+for size in $SIZES; do
+    run tcp $size
+    run uds $size
+done
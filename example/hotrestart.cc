@@ -0,0 +1,81 @@
+#include <mymuduo/TcpServer.h> // 在/usr/include/下查找
+#include <mymuduo/ListenFdHandover.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <functional>
+#include <vector>
+#include <unistd.h>
+
+// 平滑重启示例：回显服务器，回复里带上进程号
+//
+// 终端1: ./hotrestart              # 监听8888，在/tmp/hotrestart.sock上等待继任者
+// 终端2: while true; do echo hi | nc -q1 127.0.0.1 8888; done
+// 终端3: ./hotrestart              # 从旧进程取走监听socket，旧进程排空连接后退出
+// 终端2中pid平滑切换，不会出现connection refused
+class HotRestartServer
+{
+public:
+    HotRestartServer(EventLoop *loop, TcpServer *server)
+        : loop_(loop)
+        , server_(server)
+    {
+        server_->setMessageCallback(
+            std::bind(&HotRestartServer::onMessage, this,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)
+        );
+        // 交接完成且连接都关闭后退出
+        server_->setDrainCompleteCallback(std::bind(&EventLoop::quit, loop_));
+        server_->setThreadNum(2);
+    }
+
+    void start()
+    {
+        server_->start();
+    }
+
+private:
+    void onMessage(const TcpConnectionPtr &conn,
+                Buffer *buf,
+                Timestamp time)
+    {
+        std::string msg = buf->retriveAllAsString();
+        conn->send("pid " + std::to_string(::getpid()) + ": " + msg);
+        if(server_->draining())
+        {
+            conn->shutdown(); // 排空期间回复完就关闭，让客户端重连到新进程
+        }
+    }
+
+    EventLoop *loop_;
+    TcpServer *server_;
+};
+
+int main()
+{
+    const std::string handoverPath = "/tmp/hotrestart.sock";
+
+    EventLoop loop;
+    // 先尝试从正在运行的旧进程接管监听socket
+    std::vector<int> fds = ListenFdHandover::receive(handoverPath);
+    std::unique_ptr<TcpServer> server;
+    if(!fds.empty())
+    {
+        LOG_INFO("took over listen fd %d from old process", fds[0]);
+        server.reset(new TcpServer(&loop, fds[0], "hotrestart"));
+    }
+    else
+    {
+        server.reset(new TcpServer(&loop, InetAddress(8888), "hotrestart"));
+    }
+
+    HotRestartServer app(&loop, server.get());
+    app.start();
+    // 等待下一次重启，排空最多10秒
+    if(!server->enableHandover(handoverPath, 10.0))
+    {
+        LOG_ERROR("cannot wait for a successor on %s, hot restart disabled", handoverPath.c_str());
+    }
+    loop.loop();
+    return 0;
+}
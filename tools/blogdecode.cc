@@ -0,0 +1,323 @@
+// 把BinaryLog写出的二进制日志还原成文本，格式与文本日志一致，另外带上线程id
+//   [INFO]2026/10/19 15:12:05.123456 12345 : msg
+// 用法:
+//   blogdecode [-s] file.blog
+//   -s 按时间戳排序输出（各线程的记录是分段写入的，默认按文件顺序）
+
+#include "BinaryLog.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+    struct Site
+    {
+        int level;
+        int line;
+        std::string file;
+        std::string fmt;
+        std::vector<uint8_t> types;
+    };
+
+    struct Line
+    {
+        int64_t micros;
+        std::string text;
+    };
+
+    const char* const kLevelNames[] = { "[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]" };
+
+    void appendf(std::string *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    void appendf(std::string *out, const char *fmt, ...)
+    {
+        char small[256];
+        va_list args;
+        va_start(args, fmt);
+        va_list retry;
+        va_copy(retry, args);
+        int n = vsnprintf(small, sizeof small, fmt, args);
+        va_end(args);
+        if(n >= 0 && static_cast<size_t>(n) < sizeof small)
+        {
+            out->append(small, n);
+        }
+        else if(n >= 0)
+        {
+            std::string large(n + 1, '\0');
+            vsnprintf(&large[0], large.size(), fmt, retry);
+            out->append(large.data(), n);
+        }
+        va_end(retry);
+    }
+
+    // 文件读取，越界时置bad
+    class Reader
+    {
+    public:
+        Reader(const char *data, size_t len) : p_(data), end_(data + len), bad_(false) {}
+
+        bool eof() const { return p_ >= end_; }
+        bool bad() const { return bad_; }
+        size_t remaining() const { return end_ - p_; }
+
+        template <typename T>
+        T read()
+        {
+            T v = T();
+            if(remaining() < sizeof v)
+            {
+                bad_ = true;
+                p_ = end_;
+                return v;
+            }
+            memcpy(&v, p_, sizeof v);
+            p_ += sizeof v;
+            return v;
+        }
+
+        const char* take(size_t len)
+        {
+            if(remaining() < len)
+            {
+                bad_ = true;
+                p_ = end_;
+                return nullptr;
+            }
+            const char *start = p_;
+            p_ += len;
+            return start;
+        }
+
+        std::string readString()
+        {
+            uint32_t len = read<uint32_t>();
+            const char *s = take(len);
+            return s ? std::string(s, len) : std::string();
+        }
+
+    private:
+        const char *p_;
+        const char *end_;
+        bool bad_;
+    };
+
+    // 按格式串逐个转换说明取参数，每个参数用对应的C类型再交给snprintf
+    std::string render(const Site &site, Reader &args)
+    {
+        std::string out;
+        const std::string &fmt = site.fmt;
+        size_t argIndex = 0;
+        for(size_t i = 0; i < fmt.size(); ++i)
+        {
+            if(fmt[i] != '%')
+            {
+                out += fmt[i];
+                continue;
+            }
+            if(i + 1 < fmt.size() && fmt[i + 1] == '%')
+            {
+                out += '%';
+                ++i;
+                continue;
+            }
+            // % [flags] [width] [.precision] [length] conversion
+            std::string spec("%");
+            size_t j = i + 1;
+            while(j < fmt.size() && strchr("-+ #0", fmt[j])) spec += fmt[j++];
+            while(j < fmt.size() && (isdigit(fmt[j]) || fmt[j] == '.')) spec += fmt[j++];
+            while(j < fmt.size() && strchr("hlLqjzt", fmt[j])) ++j; // 长度修饰按实际编码的类型重写
+            if(j >= fmt.size() || argIndex >= site.types.size())
+            {
+                out += fmt.substr(i);
+                break;
+            }
+            char conv = fmt[j];
+            i = j;
+            switch(site.types[argIndex++])
+            {
+            case blog::kSigned:
+            case blog::kUnsigned:
+            {
+                int64_t v = args.read<int64_t>();
+                if(conv == 'c')
+                    appendf(&out, (spec + "c").c_str(), static_cast<int>(v));
+                else if(conv == 'd' || conv == 'i')
+                    appendf(&out, (spec + "ll" + conv).c_str(), static_cast<long long>(v));
+                else
+                    appendf(&out, (spec + "ll" + conv).c_str(), static_cast<unsigned long long>(v));
+                break;
+            }
+            case blog::kDouble:
+                appendf(&out, (spec + conv).c_str(), args.read<double>());
+                break;
+            case blog::kString:
+                appendf(&out, (spec + "s").c_str(), args.readString().c_str());
+                break;
+            case blog::kPointer:
+                appendf(&out, (spec + "p").c_str(), reinterpret_cast<void*>(args.read<uint64_t>()));
+                break;
+            default:
+                out += "<?>";
+                break;
+            }
+        }
+        // 文本日志的消息习惯以换行结尾，这里统一去掉再补一个
+        while(!out.empty() && out[out.size() - 1] == '\n')
+        {
+            out.erase(out.size() - 1);
+        }
+        return out;
+    }
+
+    bool readFile(const char *path, std::string *content)
+    {
+        FILE *fp = ::fopen(path, "rb");
+        if(fp == nullptr)
+        {
+            return false;
+        }
+        char buf[64 * 1024];
+        size_t n;
+        while((n = ::fread(buf, 1, sizeof buf, fp)) > 0)
+        {
+            content->append(buf, n);
+        }
+        ::fclose(fp);
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool sortByTime = false;
+    int ch;
+    while((ch = ::getopt(argc, argv, "s")) != -1)
+    {
+        switch(ch)
+        {
+        case 's': sortByTime = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-s] file.blog\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-s] file.blog\n", argv[0]);
+        return 1;
+    }
+
+    std::string content;
+    if(!readFile(argv[optind], &content))
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if(content.size() < sizeof blog::kFileMagic
+        || memcmp(content.data(), blog::kFileMagic, sizeof blog::kFileMagic) != 0)
+    {
+        fprintf(stderr, "%s: not a binary log file\n", argv[optind]);
+        return 1;
+    }
+
+    Reader reader(content.data() + sizeof blog::kFileMagic, content.size() - sizeof blog::kFileMagic);
+    std::map<uint32_t, Site> sites;
+    std::vector<Line> lines;
+    uint64_t dropped = 0;
+    while(!reader.eof() && !reader.bad())
+    {
+        char type = reader.read<char>();
+        if(type == 'S')
+        {
+            uint32_t id = reader.read<uint32_t>();
+            Site &site = sites[id];
+            site.level = reader.read<int32_t>();
+            site.line = reader.read<int32_t>();
+            uint32_t nargs = reader.read<uint32_t>();
+            const char *types = reader.take(nargs);
+            if(types)
+            {
+                site.types.assign(types, types + nargs);
+            }
+            site.file = reader.readString();
+            site.fmt = reader.readString();
+        }
+        else if(type == 'R')
+        {
+            int32_t tid = reader.read<int32_t>();
+            uint32_t nbytes = reader.read<uint32_t>();
+            const char *chunk = reader.take(nbytes);
+            if(chunk == nullptr)
+            {
+                break;
+            }
+            Reader records(chunk, nbytes);
+            while(records.remaining() >= 8)
+            {
+                uint32_t siteId = records.read<uint32_t>();
+                uint32_t size = records.read<uint32_t>();
+                if(size < 8 || size - 8 > records.remaining())
+                {
+                    fprintf(stderr, "corrupted record in thread %d\n", tid);
+                    break;
+                }
+                Reader record(records.take(size - 8), size - 8);
+                if(siteId == blog::kPadSite)
+                {
+                    continue;
+                }
+                int64_t micros = record.read<int64_t>();
+                std::map<uint32_t, Site>::const_iterator it = sites.find(siteId);
+                if(it == sites.end())
+                {
+                    fprintf(stderr, "unknown site %u in thread %d\n", siteId, tid);
+                    continue;
+                }
+                const Site &site = it->second;
+                char timebuf[Timestamp::kFormattedSize];
+                size_t timelen = Timestamp(micros).formatTo(timebuf, sizeof timebuf);
+                Line line;
+                line.micros = micros;
+                line.text = (site.level >= 0 && site.level <= FATAL) ? kLevelNames[site.level] : "[?]";
+                line.text.append(timebuf, timelen);
+                appendf(&line.text, " %d : ", tid);
+                line.text += render(site, record);
+                line.text += '\n';
+                lines.push_back(std::move(line));
+            }
+        }
+        else if(type == 'D')
+        {
+            dropped += reader.read<uint64_t>();
+        }
+        else
+        {
+            fprintf(stderr, "unknown section '%c', file truncated?\n", type);
+            break;
+        }
+    }
+
+    if(sortByTime)
+    {
+        std::stable_sort(lines.begin(), lines.end(), [](const Line &a, const Line &b) {
+            return a.micros < b.micros;
+        });
+    }
+    for(const Line &line : lines)
+    {
+        fwrite(line.text.data(), 1, line.text.size(), stdout);
+    }
+    if(dropped > 0)
+    {
+        fprintf(stderr, "%llu records dropped (ring full)\n", static_cast<unsigned long long>(dropped));
+    }
+    return 0;
+}